@@ -0,0 +1,232 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+// Microbenchmark and self-check for the one's-complement kernels in
+// checksum.h. Needs nothing from ns-3, so it also builds on its own:
+//   g++ -O2 -o checksum-bench checksum-bench.cc && ./checksum-bench
+
+#include "checksum.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+using namespace ns3;
+
+static volatile uint64_t g_sink;
+
+// textbook RFC 1071 loop over big-endian 16-bit words
+static uint16_t
+ReferenceChecksum (const uint8_t *data, uint32_t size)
+{
+  uint32_t sum = 0;
+  for (uint32_t i = 0; i + 1 < size; i += 2)
+    {
+      sum += (data[i] << 8) | data[i + 1];
+    }
+  if (size & 1)
+    {
+      sum += data[size - 1] << 8;
+    }
+  while (sum >> 16)
+    {
+      sum = (sum & 0xffff) + (sum >> 16);
+    }
+  return (uint16_t) ~sum;
+}
+
+static uint16_t
+ToNetwork (uint16_t check)
+{
+  uint8_t bytes[2];
+  std::memcpy (bytes, &check, 2);
+  return (bytes[0] << 8) | bytes[1];
+}
+
+struct Kernel
+{
+  const char *name;
+  ChecksumKernel kernel;
+  bool supported;
+};
+
+static bool
+SelfCheck (const std::vector<Kernel> &kernels)
+{
+  std::vector<uint8_t> buffer (1600 + 64);
+  for (uint32_t i = 0; i < buffer.size (); ++i)
+    {
+      buffer[i] = std::rand () & 0xff;
+    }
+  for (uint32_t size = 0; size <= 1600; ++size)
+    {
+      for (uint32_t align = 0; align < 8; ++align)
+        {
+          uint16_t expected = ReferenceChecksum (&buffer[align], size);
+          for (uint32_t k = 0; k < kernels.size (); ++k)
+            {
+              if (!kernels[k].supported)
+                {
+                  continue;
+                }
+              uint16_t got = ToNetwork (ChecksumFold (kernels[k].kernel (&buffer[align], size, 0)));
+              if (got != expected)
+                {
+                  std::printf ("FAIL: %s size %u offset %u: %04x, expected %04x\n", kernels[k].name, size, align, got, expected);
+                  return false;
+                }
+            }
+        }
+    }
+
+  // incremental updates must match a full recompute
+  for (uint32_t i = 0; i < 10000; ++i)
+    {
+      uint8_t header[20];
+      for (uint32_t j = 0; j < 20; ++j)
+        {
+          header[j] = std::rand () & 0xff;
+        }
+      header[10] = header[11] = 0;
+      uint16_t check = ChecksumFold (ChecksumAccumulate (header, 20));
+      uint16_t oldWord;
+      uint32_t oldAddress;
+      std::memcpy (&oldWord, header + 8, 2);
+      std::memcpy (&oldAddress, header + 12, 4);
+      header[8]--;
+      header[12] ^= 0x5a;
+      header[15] += 7;
+      uint16_t newWord;
+      uint32_t newAddress;
+      std::memcpy (&newWord, header + 8, 2);
+      std::memcpy (&newAddress, header + 12, 4);
+      uint16_t updated = ChecksumUpdate32 (ChecksumUpdate16 (check, oldWord, newWord), oldAddress, newAddress);
+      // 0x0000 and 0xffff are the same value in one's complement
+      uint16_t full = ChecksumFold (ChecksumAccumulate (header, 20));
+      if (updated != full && !((uint16_t) (updated + 1) <= 1 && (uint16_t) (full + 1) <= 1))
+        {
+          std::printf ("FAIL: incremental update %04x, full recompute %04x\n", updated, full);
+          return false;
+        }
+    }
+
+  // a datagram patched at the next hop must match one filled in from scratch
+  const uint8_t protocols[] = { 1, 6, 17 };
+  for (uint32_t i = 0; i < 3000; ++i)
+    {
+      uint32_t size = 40 + std::rand () % 1400;
+      std::vector<uint8_t> sent (size);
+      for (uint32_t j = 0; j < size; ++j)
+        {
+          sent[j] = std::rand () & 0xff;
+        }
+      sent[0] = 0x45;
+      sent[2] = size >> 8;
+      sent[3] = size & 0xff;
+      sent[6] = sent[7] = 0;
+      sent[9] = protocols[i % 3];
+      sent[10] = sent[11] = 0;
+      std::vector<uint8_t> hop = sent;
+      FillChecksums (&sent[0], size, CHECKSUM_ALL);
+      hop[8]--;
+      std::vector<uint8_t> full = hop;
+      FillChecksums (&full[0], size, CHECKSUM_ALL);
+      if (!ForwardChecksums (&hop[0], size, &sent[0], 40, CHECKSUM_ALL) || hop != full)
+        {
+          std::printf ("FAIL: forwarded checksums differ from a full fill (protocol %u, %u bytes)\n", protocols[i % 3], size);
+          return false;
+        }
+      hop[12] ^= 1;
+      if (ForwardChecksums (&hop[0], size, &sent[0], 40, CHECKSUM_ALL))
+        {
+          std::printf ("FAIL: forwarded checksums accepted a changed address\n");
+          return false;
+        }
+    }
+  return true;
+}
+
+template <typename F>
+static double
+NsPerCall (uint64_t iterations, F f)
+{
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now ();
+  for (uint64_t i = 0; i < iterations; ++i)
+    {
+      f (i);
+    }
+  std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now () - start;
+  return elapsed.count () / iterations;
+}
+
+int
+main (int argc, char *argv[])
+{
+  uint64_t iterations = 2000000;
+  if (argc > 1)
+    {
+      iterations = std::strtoull (argv[1], 0, 10);
+    }
+
+  std::vector<Kernel> kernels;
+  kernels.push_back ({"scalar", &ChecksumAccumulateScalar, true});
+#ifdef CHECKSUM_X86
+  kernels.push_back ({"sse2", &ChecksumAccumulateSse2, (bool) __builtin_cpu_supports ("sse2")});
+  kernels.push_back ({"avx2", &ChecksumAccumulateAvx2, (bool) __builtin_cpu_supports ("avx2")});
+#endif
+
+  if (!SelfCheck (kernels))
+    {
+      return 1;
+    }
+  std::printf ("self-check passed\n");
+
+  // 137 bytes: odd-sized small datagram; 1024 bytes: the scripts' echo payload
+  std::vector<uint8_t> buffer (1024 + 1);
+  for (uint32_t i = 0; i < buffer.size (); ++i)
+    {
+      buffer[i] = i * 31;
+    }
+  const uint32_t sizes[] = { 137, 1024 };
+  for (uint32_t s = 0; s < 2; ++s)
+    {
+      for (uint32_t k = 0; k < kernels.size (); ++k)
+        {
+          if (!kernels[k].supported)
+            {
+              std::printf ("%-6s %5u bytes: not supported on this CPU\n", kernels[k].name, sizes[s]);
+              continue;
+            }
+          ChecksumKernel kernel = kernels[k].kernel;
+          uint32_t size = sizes[s];
+          const uint8_t *data = &buffer[0];
+          double ns = NsPerCall (iterations, [&] (uint64_t i) { g_sink = g_sink + ChecksumFold (kernel (data + (i & 1), size, 0)); });
+          std::printf ("%-6s %5u bytes: %8.2f ns/call %6.2f GB/s\n", kernels[k].name, size, ns, size / ns);
+        }
+    }
+
+  // router TTL decrement and NAT address rewrite: update vs recompute
+  uint8_t header[20] = { 0x45, 0, 0, 137, 0, 0, 0, 0, 64, 17, 0, 0, 10, 1, 1, 1, 10, 1, 2, 4 };
+  uint16_t check = ChecksumFold (ChecksumAccumulate (header, 20));
+  double full = NsPerCall (iterations, [&] (uint64_t i) {
+    header[8] = (uint8_t) i;
+    header[10] = header[11] = 0;
+    g_sink = g_sink + ChecksumFold (ChecksumAccumulate (header, 20));
+  });
+  double incremental = NsPerCall (iterations, [&] (uint64_t i) {
+    uint16_t oldWord = (uint16_t) i;
+    g_sink = g_sink + ChecksumUpdate16 (check, oldWord, (uint16_t) (oldWord - 1));
+  });
+  std::printf ("ttl decrement, 20 byte header: recompute %.2f ns, incremental %.2f ns\n", full, incremental);
+
+  uint16_t payloadCheck = ChecksumFold (ChecksumAccumulate (&buffer[0], 1024));
+  full = NsPerCall (iterations, [&] (uint64_t i) {
+    uint32_t address = (uint32_t) i;
+    std::memcpy (&buffer[12], &address, 4);
+    g_sink = g_sink + ChecksumFold (ChecksumAccumulate (&buffer[0], 1024));
+  });
+  incremental = NsPerCall (iterations, [&] (uint64_t i) {
+    g_sink = g_sink + ChecksumUpdate32 (payloadCheck, (uint32_t) i, (uint32_t) i + 1);
+  });
+  std::printf ("address rewrite, 1024 byte datagram: recompute %.2f ns, incremental %.2f ns\n", full, incremental);
+  return 0;
+}
@@ -0,0 +1,168 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+#ifndef CHECKSUM_PCAP_H
+#define CHECKSUM_PCAP_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/point-to-point-module.h"
+#include "ns3/csma-module.h"
+#include "checksum.h"
+#include <string>
+#include <vector>
+
+namespace ns3 {
+
+/*
+ * pcap tracing that fills in checksums of the chosen protocols as each frame
+ * is written. ns-3 only has the one ChecksumEnabled switch and pays for it on
+ * every simulated header; here the simulation runs with checksums off and only
+ * the trace output is checksummed, with the kernels from checksum.h.
+ *
+ * Files get the same names and link types as the stock helpers give them
+ * (PPP for point-to-point, DIX ethernet for CSMA), so they can replace
+ * EnablePcap calls one for one.
+ *
+ * A packet keeps its uid, and its payload, as it is forwarded, so when the
+ * same datagram is written again at a later hop, its checksums are patched
+ * from the previous hop with ForwardChecksums rather than computed again.
+ */
+class ChecksumPcapHelper
+{
+public:
+  ChecksumPcapHelper (uint32_t protocols)
+    : m_protocols (protocols)
+  {
+  }
+
+  // datagrams checksummed in full, and ones patched from the previous hop
+  static uint64_t GetFilled (void)
+  {
+    return Stats ().filled;
+  }
+
+  static uint64_t GetForwarded (void)
+  {
+    return Stats ().forwarded;
+  }
+
+  void Enable (const std::string &prefix, NetDeviceContainer devices, bool promiscuous = false)
+  {
+    for (NetDeviceContainer::Iterator i = devices.Begin (); i != devices.End (); ++i)
+      {
+        Enable (prefix, *i, promiscuous);
+      }
+  }
+
+  void Enable (const std::string &prefix, Ptr<NetDevice> device, bool promiscuous = false)
+  {
+    PcapHelper pcapHelper;
+    std::string filename = pcapHelper.GetFilenameFromDevice (prefix, device);
+    Ptr<PcapFileWrapper> file;
+    if (DynamicCast<PointToPointNetDevice> (device))
+      {
+        // point-to-point devices are always traced promiscuously
+        file = pcapHelper.CreateFile (filename, std::ios::out, PcapHelper::DLT_PPP);
+        device->TraceConnectWithoutContext ("PromiscSniffer", MakeBoundCallback (&ChecksumPcapHelper::WritePpp, file, m_protocols));
+      }
+    else if (DynamicCast<CsmaNetDevice> (device))
+      {
+        file = pcapHelper.CreateFile (filename, std::ios::out, PcapHelper::DLT_EN10MB);
+        device->TraceConnectWithoutContext (promiscuous ? "PromiscSniffer" : "Sniffer",
+                                            MakeBoundCallback (&ChecksumPcapHelper::WriteEthernet, file, m_protocols));
+      }
+    else
+      {
+        NS_FATAL_ERROR ("no checksummed pcap framing for " << device->GetInstanceTypeId ().GetName ());
+      }
+  }
+
+private:
+  // enough for a 60-byte IPv4 header and a TCP header up to its checksum
+  static const uint32_t FILLED_BYTES = 80;
+  static const uint32_t FILLED_SLOTS = 64;
+
+  // the start of a recently written datagram, after its checksums were filled
+  struct Filled
+  {
+    uint64_t uid;
+    uint32_t protocols;
+    uint32_t size;
+    uint8_t bytes[FILLED_BYTES];
+  };
+
+  struct Counters
+  {
+    uint64_t filled;
+    uint64_t forwarded;
+  };
+
+  static Counters &Stats (void)
+  {
+    static Counters counters = { 0, 0 };
+    return counters;
+  }
+
+  static Filled &FilledSlot (uint64_t uid)
+  {
+    static std::vector<Filled> slots;
+    if (slots.empty ())
+      {
+        Filled empty;
+        empty.uid = ~(uint64_t) 0;
+        slots.resize (FILLED_SLOTS, empty);
+      }
+    return slots[uid % FILLED_SLOTS];
+  }
+
+  static void WritePpp (Ptr<PcapFileWrapper> file, uint32_t protocols, Ptr<const Packet> packet)
+  {
+    // 2-byte PPP protocol field; 0x0021 is IPv4
+    Write (file, protocols, packet, 2, 0x0021);
+  }
+
+  static void WriteEthernet (Ptr<PcapFileWrapper> file, uint32_t protocols, Ptr<const Packet> packet)
+  {
+    // the ethertype ends the 14-byte DIX header
+    Write (file, protocols, packet, 14, 0x0800);
+  }
+
+  static void Write (Ptr<PcapFileWrapper> file, uint32_t protocols, Ptr<const Packet> packet,
+                     uint32_t ipOffset, uint16_t ipv4Type)
+  {
+    // one scratch buffer for every trace; it only grows
+    static std::vector<uint8_t> buffer;
+    uint32_t size = packet->GetSize ();
+    if (buffer.size () < size)
+      {
+        buffer.resize (size);
+      }
+    packet->CopyData (&buffer[0], size);
+    if (size > ipOffset && ((buffer[ipOffset - 2] << 8) | buffer[ipOffset - 1]) == ipv4Type)
+      {
+        uint8_t *ip = &buffer[ipOffset];
+        uint32_t ipSize = size - ipOffset;
+        Filled &filled = FilledSlot (packet->GetUid ());
+        if (filled.uid == packet->GetUid () && filled.protocols == protocols
+            && ForwardChecksums (ip, ipSize, filled.bytes, filled.size, protocols))
+          {
+            Stats ().forwarded++;
+          }
+        else
+          {
+            FillChecksums (ip, ipSize, protocols);
+            Stats ().filled++;
+          }
+        filled.uid = packet->GetUid ();
+        filled.protocols = protocols;
+        filled.size = ipSize < FILLED_BYTES ? ipSize : FILLED_BYTES;
+        std::memcpy (filled.bytes, ip, filled.size);
+      }
+    file->Write (Simulator::Now (), &buffer[0], size);
+  }
+
+  uint32_t m_protocols;
+};
+
+} // namespace ns3
+
+#endif /* CHECKSUM_PCAP_H */
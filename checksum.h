@@ -0,0 +1,352 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+#ifndef CHECKSUM_H
+#define CHECKSUM_H
+
+#include <stdint.h>
+#include <cstring>
+#include <sstream>
+#include <string>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define CHECKSUM_X86 1
+#endif
+
+namespace ns3 {
+
+/*
+ * Internet (RFC 1071) one's-complement checksum.
+ *
+ * The sum is taken over native-order words. One's-complement addition is
+ * byte-order independent, so a folded native sum stored back with memcpy is
+ * already in network order. ChecksumAccumulate* return a partial sum that can
+ * be carried into the next buffer (e.g. pseudo header, then payload) as long as
+ * every buffer but the last has even length; ChecksumFold turns it into the
+ * 16-bit field value.
+ */
+
+inline uint64_t
+ChecksumAccumulateScalar (const uint8_t *data, uint32_t size, uint64_t sum)
+{
+  // four 64-bit loads per step, each added as two 32-bit halves so the
+  // accumulator cannot overflow
+  while (size >= 32)
+    {
+      uint64_t w[4];
+      std::memcpy (w, data, 32);
+      sum += (w[0] & 0xffffffff) + (w[0] >> 32) + (w[1] & 0xffffffff) + (w[1] >> 32)
+        + (w[2] & 0xffffffff) + (w[2] >> 32) + (w[3] & 0xffffffff) + (w[3] >> 32);
+      data += 32;
+      size -= 32;
+    }
+  while (size >= 4)
+    {
+      uint32_t w;
+      std::memcpy (&w, data, 4);
+      sum += w;
+      data += 4;
+      size -= 4;
+    }
+  if (size >= 2)
+    {
+      uint16_t w;
+      std::memcpy (&w, data, 2);
+      sum += w;
+      data += 2;
+      size -= 2;
+    }
+  if (size)
+    {
+      // odd trailing byte, padded with a zero byte in network order
+      uint8_t pad[2] = { data[0], 0 };
+      uint16_t w;
+      std::memcpy (&w, pad, 2);
+      sum += w;
+    }
+  return sum;
+}
+
+#ifdef CHECKSUM_X86
+// 32-bit words are zero-extended into 64-bit lanes, so lane sums never carry out
+__attribute__ ((target ("sse2"))) inline uint64_t
+ChecksumAccumulateSse2 (const uint8_t *data, uint32_t size, uint64_t sum)
+{
+  const __m128i zero = _mm_setzero_si128 ();
+  __m128i acc0 = zero;
+  __m128i acc1 = zero;
+  while (size >= 32)
+    {
+      __m128i a = _mm_loadu_si128 ((const __m128i *) data);
+      __m128i b = _mm_loadu_si128 ((const __m128i *) (data + 16));
+      acc0 = _mm_add_epi64 (acc0, _mm_unpacklo_epi32 (a, zero));
+      acc1 = _mm_add_epi64 (acc1, _mm_unpackhi_epi32 (a, zero));
+      acc0 = _mm_add_epi64 (acc0, _mm_unpacklo_epi32 (b, zero));
+      acc1 = _mm_add_epi64 (acc1, _mm_unpackhi_epi32 (b, zero));
+      data += 32;
+      size -= 32;
+    }
+  uint64_t lanes[2];
+  _mm_storeu_si128 ((__m128i *) lanes, _mm_add_epi64 (acc0, acc1));
+  return ChecksumAccumulateScalar (data, size, sum + lanes[0] + lanes[1]);
+}
+
+__attribute__ ((target ("avx2"))) inline uint64_t
+ChecksumAccumulateAvx2 (const uint8_t *data, uint32_t size, uint64_t sum)
+{
+  const __m256i zero = _mm256_setzero_si256 ();
+  __m256i acc0 = zero;
+  __m256i acc1 = zero;
+  while (size >= 64)
+    {
+      __m256i a = _mm256_loadu_si256 ((const __m256i *) data);
+      __m256i b = _mm256_loadu_si256 ((const __m256i *) (data + 32));
+      acc0 = _mm256_add_epi64 (acc0, _mm256_unpacklo_epi32 (a, zero));
+      acc1 = _mm256_add_epi64 (acc1, _mm256_unpackhi_epi32 (a, zero));
+      acc0 = _mm256_add_epi64 (acc0, _mm256_unpacklo_epi32 (b, zero));
+      acc1 = _mm256_add_epi64 (acc1, _mm256_unpackhi_epi32 (b, zero));
+      data += 64;
+      size -= 64;
+    }
+  uint64_t lanes[4];
+  _mm256_storeu_si256 ((__m256i *) lanes, _mm256_add_epi64 (acc0, acc1));
+  return ChecksumAccumulateSse2 (data, size, sum + lanes[0] + lanes[1] + lanes[2] + lanes[3]);
+}
+#endif
+
+typedef uint64_t (*ChecksumKernel) (const uint8_t *data, uint32_t size, uint64_t sum);
+
+// widest kernel this CPU supports, picked once
+inline ChecksumKernel
+ChecksumBestKernel (void)
+{
+#ifdef CHECKSUM_X86
+  static const ChecksumKernel best = __builtin_cpu_supports ("avx2") ? &ChecksumAccumulateAvx2
+    : __builtin_cpu_supports ("sse2") ? &ChecksumAccumulateSse2 : &ChecksumAccumulateScalar;
+  return best;
+#else
+  return &ChecksumAccumulateScalar;
+#endif
+}
+
+inline uint64_t
+ChecksumAccumulate (const uint8_t *data, uint32_t size, uint64_t sum = 0)
+{
+  return ChecksumBestKernel () (data, size, sum);
+}
+
+// fold a partial sum to 16 bits and complement it; store the result with memcpy
+inline uint16_t
+ChecksumFold (uint64_t sum)
+{
+  sum = (sum & 0xffffffff) + (sum >> 32);
+  sum = (sum & 0xffffffff) + (sum >> 32);
+  sum = (sum & 0xffff) + (sum >> 16);
+  sum = (sum & 0xffff) + (sum >> 16);
+  return (uint16_t) ~sum;
+}
+
+/*
+ * Incremental update (RFC 1624, eqn. 3): HC' = ~(~HC + ~m + m'), for a field
+ * that changed from m to m'. All three values are read the same way
+ * (native loads of the network-order bytes), like the full sum.
+ */
+inline uint16_t
+ChecksumUpdate16 (uint16_t check, uint16_t oldValue, uint16_t newValue)
+{
+  uint32_t sum = (uint16_t) ~check + (uint16_t) ~oldValue + (uint32_t) newValue;
+  sum = (sum & 0xffff) + (sum >> 16);
+  sum = (sum & 0xffff) + (sum >> 16);
+  return (uint16_t) ~sum;
+}
+
+inline uint16_t
+ChecksumUpdate32 (uint16_t check, uint32_t oldValue, uint32_t newValue)
+{
+  check = ChecksumUpdate16 (check, (uint16_t) oldValue, (uint16_t) newValue);
+  return ChecksumUpdate16 (check, (uint16_t) (oldValue >> 16), (uint16_t) (newValue >> 16));
+}
+
+// protocols whose checksum fields FillChecksums writes
+enum
+{
+  CHECKSUM_IPV4 = 1,
+  CHECKSUM_ICMP = 2,
+  CHECKSUM_UDP = 4,
+  CHECKSUM_TCP = 8,
+  CHECKSUM_ALL = CHECKSUM_IPV4 | CHECKSUM_ICMP | CHECKSUM_UDP | CHECKSUM_TCP
+};
+
+// "ipv4,udp", "all" or "none"; false on an unknown name
+inline bool
+ParseChecksumProtocols (const std::string &list, uint32_t &protocols)
+{
+  protocols = 0;
+  std::istringstream is (list);
+  std::string name;
+  while (std::getline (is, name, ','))
+    {
+      if (name == "ipv4")
+        {
+          protocols |= CHECKSUM_IPV4;
+        }
+      else if (name == "icmp")
+        {
+          protocols |= CHECKSUM_ICMP;
+        }
+      else if (name == "udp")
+        {
+          protocols |= CHECKSUM_UDP;
+        }
+      else if (name == "tcp")
+        {
+          protocols |= CHECKSUM_TCP;
+        }
+      else if (name == "all")
+        {
+          protocols |= CHECKSUM_ALL;
+        }
+      else if (name != "none" && !name.empty ())
+        {
+          return false;
+        }
+    }
+  return true;
+}
+
+/*
+ * Write the checksum fields of the selected protocols into an IPv4 datagram
+ * that starts at ip and has size bytes available. Fragments only get the
+ * IPv4 header checksum, since their transport checksum covers the whole
+ * reassembled payload.
+ */
+inline void
+FillChecksums (uint8_t *ip, uint32_t size, uint32_t protocols)
+{
+  if (size < 20 || (ip[0] >> 4) != 4)
+    {
+      return;
+    }
+  uint32_t headerSize = (ip[0] & 0x0f) * 4;
+  uint32_t totalSize = (ip[2] << 8) | ip[3];
+  if (headerSize < 20 || totalSize < headerSize || totalSize > size)
+    {
+      return;
+    }
+  if (protocols & CHECKSUM_IPV4)
+    {
+      ip[10] = ip[11] = 0;
+      uint16_t check = ChecksumFold (ChecksumAccumulate (ip, headerSize));
+      std::memcpy (ip + 10, &check, 2);
+    }
+  if (((ip[6] << 8) | ip[7]) & 0x3fff)
+    {
+      return;
+    }
+
+  uint8_t *l4 = ip + headerSize;
+  uint32_t l4Size = totalSize - headerSize;
+  uint8_t protocol = ip[9];
+  uint32_t offset;
+  if (protocol == 1 && (protocols & CHECKSUM_ICMP) && l4Size >= 4)
+    {
+      l4[2] = l4[3] = 0;
+      uint16_t check = ChecksumFold (ChecksumAccumulate (l4, l4Size));
+      std::memcpy (l4 + 2, &check, 2);
+      return;
+    }
+  else if (protocol == 17 && (protocols & CHECKSUM_UDP) && l4Size >= 8)
+    {
+      offset = 6;
+    }
+  else if (protocol == 6 && (protocols & CHECKSUM_TCP) && l4Size >= 20)
+    {
+      offset = 16;
+    }
+  else
+    {
+      return;
+    }
+
+  // pseudo header: source, destination, zero, protocol, transport length
+  uint8_t pseudo[12];
+  std::memcpy (pseudo, ip + 12, 8);
+  pseudo[8] = 0;
+  pseudo[9] = protocol;
+  pseudo[10] = l4Size >> 8;
+  pseudo[11] = l4Size & 0xff;
+  l4[offset] = l4[offset + 1] = 0;
+  uint16_t check = ChecksumFold (ChecksumAccumulate (l4, l4Size, ChecksumAccumulate (pseudo, 12)));
+  if (protocol == 17 && check == 0)
+    {
+      // a zero UDP checksum means "none"
+      check = 0xffff;
+    }
+  std::memcpy (l4 + offset, &check, 2);
+}
+
+// offset of the checksum field in an ICMP, UDP or TCP header, or 0
+inline uint32_t
+ChecksumTransportOffset (uint8_t protocol)
+{
+  switch (protocol)
+    {
+    case 1:
+      return 2;
+    case 17:
+      return 6;
+    case 6:
+      return 16;
+    default:
+      return 0;
+    }
+}
+
+/*
+ * Forwarding path. A router passes a datagram on with only the TTL, and so
+ * the header checksum, changed. filled holds the first filledSize bytes of
+ * the same datagram at the previous hop after FillChecksums with the same
+ * protocols: the IPv4 header plus the start of the transport header. If ip
+ * matches it apart from the TTL and checksum fields, the header checksum is
+ * patched with an RFC 1624 update and the transport checksum, whose pseudo
+ * header has no TTL, is taken over as it was, so the payload is not summed
+ * again. The caller vouches that the payload is unchanged. Returns false,
+ * leaving ip alone, when anything else differs.
+ */
+inline bool
+ForwardChecksums (uint8_t *ip, uint32_t size, const uint8_t *filled, uint32_t filledSize, uint32_t protocols)
+{
+  if (size < filledSize || filledSize < 20 || ip[0] != filled[0])
+    {
+      return false;
+    }
+  uint32_t headerSize = (ip[0] & 0x0f) * 4;
+  uint32_t checkOffset = headerSize + ChecksumTransportOffset (ip[9]);
+  for (uint32_t i = 0; i < filledSize; ++i)
+    {
+      if (ip[i] != filled[i] && i != 8 && i != 10 && i != 11
+          && !(checkOffset > headerSize && (i == checkOffset || i == checkOffset + 1)))
+        {
+          return false;
+        }
+    }
+
+  uint16_t check;
+  uint16_t oldWord;
+  uint16_t newWord;
+  std::memcpy (&check, filled + 10, 2);
+  std::memcpy (&oldWord, filled + 8, 2);
+  std::memcpy (&newWord, ip + 8, 2);
+  if (protocols & CHECKSUM_IPV4)
+    {
+      check = ChecksumUpdate16 (check, oldWord, newWord);
+      std::memcpy (ip + 10, &check, 2);
+    }
+  if (checkOffset > headerSize && checkOffset + 2 <= filledSize)
+    {
+      std::memcpy (ip + checkOffset, filled + checkOffset, 2);
+    }
+  return true;
+}
+
+} // namespace ns3
+
+#endif /* CHECKSUM_H */
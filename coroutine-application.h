@@ -0,0 +1,429 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+#ifndef COROUTINE_APPLICATION_H
+#define COROUTINE_APPLICATION_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+
+// needs a C++20 build, e.g. ./waf configure --cxx-standard=-std=c++20;
+// coroutines-check.sh builds one and compares against the callback apps
+#if __cplusplus >= 202002L && defined(__cpp_impl_coroutine)
+#define NS3_COROUTINES 1
+
+#include <coroutine>
+#include <exception>
+#include <vector>
+
+namespace ns3 {
+
+/*
+ * Applications written as C++20 coroutines. Instead of splitting its logic
+ * over member functions that schedule each other, an application runs a
+ * CoTask that suspends on
+ *
+ *   co_await CoDelay (t)                 resume after t
+ *   co_await CoRecvFrom (socket, from)   next packet, possibly a null one
+ *   co_await CoWritable (socket, bytes)  until the tx buffer has room
+ *   co_await CoConnected (socket)        true once connected
+ *
+ * Each coroutine owns one CoResumeEvent. Delays reschedule that event rather
+ * than allocating a new one per wait, and socket waits resume straight from
+ * the socket callback without scheduling anything. Frames come from
+ * CoFramePool, so a coroutine started again reuses an earlier frame.
+ */
+
+// counters for the report at the end of a run
+struct CoStats
+{
+  uint64_t framesAllocated;
+  uint64_t framesReused;
+  uint64_t delaysScheduled;
+};
+
+inline CoStats &
+GetCoStats (void)
+{
+  static CoStats stats = { 0, 0, 0 };
+  return stats;
+}
+
+// free lists of coroutine frames, one per 64-byte size class
+class CoFramePool
+{
+public:
+  static void *Allocate (std::size_t size)
+  {
+    std::vector<void *> &list = FreeList (size);
+    if (!list.empty ())
+      {
+        void *frame = list.back ();
+        list.pop_back ();
+        GetCoStats ().framesReused++;
+        return frame;
+      }
+    GetCoStats ().framesAllocated++;
+    return ::operator new (RoundUp (size));
+  }
+
+  static void Free (void *frame, std::size_t size)
+  {
+    FreeList (size).push_back (frame);
+  }
+
+private:
+  static std::size_t RoundUp (std::size_t size)
+  {
+    return (size + 63) & ~std::size_t (63);
+  }
+
+  static std::vector<void *> &FreeList (std::size_t size)
+  {
+    static std::vector<std::vector<void *> > lists;
+    std::size_t index = RoundUp (size) / 64;
+    if (lists.size () <= index)
+      {
+        lists.resize (index + 1);
+      }
+    return lists[index];
+  }
+};
+
+/*
+ * The one event a coroutine is resumed by. It is armed with what the
+ * coroutine waits for, so a socket callback that fires while the coroutine
+ * waits on something else (or after it was destroyed) is ignored.
+ */
+class CoResumeEvent : public EventImpl
+{
+public:
+  enum Wait
+  {
+    NONE,
+    DELAY,
+    RECV,
+    SEND,
+    CONNECT
+  };
+
+  CoResumeEvent ()
+    : m_wait (NONE),
+      m_recvSocket (0),
+      m_sendSocket (0),
+      m_connected (false)
+  {
+  }
+
+  void Arm (std::coroutine_handle<> handle, Wait wait)
+  {
+    m_handle = handle;
+    m_wait = wait;
+  }
+
+  void Disarm (void)
+  {
+    m_handle = std::coroutine_handle<> ();
+    m_wait = NONE;
+  }
+
+  void Resume (Wait wait)
+  {
+    if (m_wait == wait)
+      {
+        std::coroutine_handle<> handle = m_handle;
+        Disarm ();
+        handle.resume ();
+      }
+  }
+
+  // socket callbacks are installed once per socket and stay in place;
+  // replacing a callback from inside that callback would free it mid-call
+  void HookRecv (Ptr<Socket> socket)
+  {
+    if (m_recvSocket != PeekPointer (socket))
+      {
+        m_recvSocket = PeekPointer (socket);
+        socket->SetRecvCallback (MakeBoundCallback (&CoResumeEvent::OnRecv, Ptr<CoResumeEvent> (this)));
+      }
+  }
+
+  void HookSend (Ptr<Socket> socket)
+  {
+    if (m_sendSocket != PeekPointer (socket))
+      {
+        m_sendSocket = PeekPointer (socket);
+        socket->SetSendCallback (MakeBoundCallback (&CoResumeEvent::OnSend, Ptr<CoResumeEvent> (this)));
+      }
+  }
+
+  void HookConnect (Ptr<Socket> socket)
+  {
+    socket->SetConnectCallback (MakeBoundCallback (&CoResumeEvent::OnConnected, Ptr<CoResumeEvent> (this)),
+                                MakeBoundCallback (&CoResumeEvent::OnConnectFailed, Ptr<CoResumeEvent> (this)));
+  }
+
+  bool IsConnected (void) const
+  {
+    return m_connected;
+  }
+
+protected:
+  virtual void Notify (void)
+  {
+    Resume (DELAY);
+  }
+
+private:
+  static void OnRecv (Ptr<CoResumeEvent> event, Ptr<Socket> socket)
+  {
+    event->Resume (RECV);
+  }
+
+  static void OnSend (Ptr<CoResumeEvent> event, Ptr<Socket> socket, uint32_t available)
+  {
+    event->Resume (SEND);
+  }
+
+  static void OnConnected (Ptr<CoResumeEvent> event, Ptr<Socket> socket)
+  {
+    event->m_connected = true;
+    event->Resume (CONNECT);
+  }
+
+  static void OnConnectFailed (Ptr<CoResumeEvent> event, Ptr<Socket> socket)
+  {
+    event->m_connected = false;
+    event->Resume (CONNECT);
+  }
+
+  std::coroutine_handle<> m_handle;
+  Wait m_wait;
+  // only compared, never dereferenced: the socket's callbacks hold this event
+  Socket *m_recvSocket;
+  Socket *m_sendSocket;
+  bool m_connected;
+};
+
+// a running coroutine; destroying the task destroys its frame
+class CoTask
+{
+public:
+  struct promise_type
+  {
+    promise_type ()
+      : resume (Create<CoResumeEvent> ())
+    {
+    }
+
+    CoTask get_return_object (void)
+    {
+      return CoTask (std::coroutine_handle<promise_type>::from_promise (*this));
+    }
+
+    // run up to the first co_await when started
+    std::suspend_never initial_suspend (void) noexcept
+    {
+      return {};
+    }
+
+    // keep the frame until the task is destroyed
+    std::suspend_always final_suspend (void) noexcept
+    {
+      return {};
+    }
+
+    void return_void (void)
+    {
+    }
+
+    void unhandled_exception (void)
+    {
+      std::terminate ();
+    }
+
+    static void *operator new (std::size_t size)
+    {
+      return CoFramePool::Allocate (size);
+    }
+
+    static void operator delete (void *frame, std::size_t size)
+    {
+      CoFramePool::Free (frame, size);
+    }
+
+    Ptr<CoResumeEvent> resume;
+  };
+
+  typedef std::coroutine_handle<promise_type> Handle;
+
+  CoTask ()
+  {
+  }
+
+  CoTask (CoTask &&other)
+    : m_handle (other.m_handle)
+  {
+    other.m_handle = Handle ();
+  }
+
+  CoTask &operator= (CoTask &&other)
+  {
+    if (this != &other)
+      {
+        Destroy ();
+        m_handle = other.m_handle;
+        other.m_handle = Handle ();
+      }
+    return *this;
+  }
+
+  ~CoTask ()
+  {
+    Destroy ();
+  }
+
+  // a pending delay or socket callback finds the event disarmed and does nothing
+  void Destroy (void)
+  {
+    if (m_handle)
+      {
+        m_handle.promise ().resume->Disarm ();
+        m_handle.destroy ();
+        m_handle = Handle ();
+      }
+  }
+
+private:
+  explicit CoTask (Handle handle)
+    : m_handle (handle)
+  {
+  }
+
+  Handle m_handle;
+};
+
+struct CoDelay
+{
+  explicit CoDelay (Time delay)
+    : m_delay (delay)
+  {
+  }
+
+  bool await_ready (void) const noexcept
+  {
+    return false;
+  }
+
+  void await_suspend (CoTask::Handle handle)
+  {
+    Ptr<CoResumeEvent> resume = handle.promise ().resume;
+    resume->Arm (handle, CoResumeEvent::DELAY);
+    Ptr<EventImpl> event = resume;
+    Simulator::Schedule (m_delay, event);
+    GetCoStats ().delaysScheduled++;
+  }
+
+  void await_resume (void) const noexcept
+  {
+  }
+
+  Time m_delay;
+};
+
+struct CoRecvFrom
+{
+  CoRecvFrom (Ptr<Socket> socket, Address &from)
+    : m_socket (socket),
+      m_from (from)
+  {
+  }
+
+  bool await_ready (void)
+  {
+    m_packet = m_socket->RecvFrom (m_from);
+    return m_packet != 0;
+  }
+
+  void await_suspend (CoTask::Handle handle)
+  {
+    Ptr<CoResumeEvent> resume = handle.promise ().resume;
+    resume->HookRecv (m_socket);
+    resume->Arm (handle, CoResumeEvent::RECV);
+  }
+
+  // null when the callback fired without data (e.g. a TCP close)
+  Ptr<Packet> await_resume (void)
+  {
+    if (!m_packet)
+      {
+        m_packet = m_socket->RecvFrom (m_from);
+      }
+    return m_packet;
+  }
+
+  Ptr<Socket> m_socket;
+  Address &m_from;
+  Ptr<Packet> m_packet;
+};
+
+struct CoWritable
+{
+  CoWritable (Ptr<Socket> socket, uint32_t bytes)
+    : m_socket (socket),
+      m_bytes (bytes)
+  {
+  }
+
+  bool await_ready (void) const
+  {
+    return m_socket->GetTxAvailable () >= m_bytes;
+  }
+
+  void await_suspend (CoTask::Handle handle)
+  {
+    Ptr<CoResumeEvent> resume = handle.promise ().resume;
+    resume->HookSend (m_socket);
+    resume->Arm (handle, CoResumeEvent::SEND);
+  }
+
+  void await_resume (void) const
+  {
+  }
+
+  Ptr<Socket> m_socket;
+  uint32_t m_bytes;
+};
+
+// await after Socket::Connect; resumes with whether the connection succeeded
+struct CoConnected
+{
+  explicit CoConnected (Ptr<Socket> socket)
+    : m_socket (socket)
+  {
+  }
+
+  bool await_ready (void) const
+  {
+    return false;
+  }
+
+  void await_suspend (CoTask::Handle handle)
+  {
+    m_resume = handle.promise ().resume;
+    m_resume->HookConnect (m_socket);
+    m_resume->Arm (handle, CoResumeEvent::CONNECT);
+  }
+
+  bool await_resume (void) const
+  {
+    return m_resume->IsConnected ();
+  }
+
+  Ptr<Socket> m_socket;
+  Ptr<CoResumeEvent> m_resume;
+};
+
+} // namespace ns3
+
+#endif /* C++20 coroutines */
+
+#endif /* COROUTINE_APPLICATION_H */
@@ -0,0 +1,78 @@
+#!/bin/sh
+# Builds ns-3 as C++20 and checks the coroutine applications in p2p.cc and
+# star.cc against the callback versions. For each scenario it:
+#   - runs it with and without --coroutines;
+#   - fails if the --coroutines run reports that coroutine-application.h was
+#     left out of the build, or prints no coroutine frame counts;
+#   - fails unless both runs receive the same number of packets.
+# Event counts and wall time per packet of both runs are printed side by side.
+#
+#   NS3_DIR=~/ns-3-dev ./coroutines-check.sh [--no-configure] [configure args]
+#
+# The scenario scripts must be in $NS3_DIR/scratch. The tree is reconfigured
+# with --cxx-standard=-std=c++20 (plus any extra configure args) and rebuilt,
+# unless --no-configure says it already is. GCC 10 also needs
+# CXXFLAGS=-fcoroutines in the environment; later compilers do not.
+
+NS3_DIR=${NS3_DIR:?set NS3_DIR to the ns-3 tree with these scripts in scratch/}
+CONFIGURE=1
+if [ "$1" = "--no-configure" ]; then
+  CONFIGURE=0
+  shift
+fi
+
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+if [ $CONFIGURE -eq 1 ]; then
+  if ! (cd "$NS3_DIR" && ./waf configure --cxx-standard=-std=c++20 --disable-werror "$@") > "$WORK/configure.log" 2>&1; then
+    tail -n 20 "$WORK/configure.log"
+    echo "FAIL: ns-3 did not configure as C++20"
+    exit 1
+  fi
+fi
+if ! (cd "$NS3_DIR" && ./waf build) > "$WORK/build.log" 2>&1; then
+  grep -B 2 -A 8 "error" "$WORK/build.log" | head -n 60
+  echo "FAIL: the C++20 build failed"
+  exit 1
+fi
+
+run ()
+{
+  if ! "$NS3_DIR/waf" --cwd="$WORK" --run "$2" > "$WORK/$1.log" 2>&1; then
+    tail -n 20 "$WORK/$1.log"
+    echo "FAIL: $2 did not run"
+    exit 1
+  fi
+}
+
+# field N of "Events scheduled S, event objects created C, executed E, packets P, wall W ms, ..."
+events_field ()
+{
+  sed -n "s/^Events scheduled \([0-9]*\), event objects created \([0-9]*\), executed \([0-9]*\), packets \([0-9]*\), wall \([0-9]*\) ms.*/\\$2/p" "$WORK/$1.log"
+}
+
+status=0
+for scenario in p2p star; do
+  run "$scenario-callbacks" "$scenario"
+  run "$scenario-coroutines" "$scenario --coroutines"
+  if grep -q "needs ns-3 built as C++20" "$WORK/$scenario-coroutines.log" \
+     || ! grep -q "^Coroutine frames allocated" "$WORK/$scenario-coroutines.log"; then
+    echo "FAIL: $scenario was built without the coroutine applications"
+    status=1
+    continue
+  fi
+  for mode in callbacks coroutines; do
+    printf '%-5s %-10s scheduled %s, event objects created %s, executed %s, packets %s, wall %s ms\n' \
+      "$scenario" "$mode" "$(events_field $scenario-$mode 1)" "$(events_field $scenario-$mode 2)" \
+      "$(events_field $scenario-$mode 3)" "$(events_field $scenario-$mode 4)" "$(events_field $scenario-$mode 5)"
+  done
+  grep "^Coroutine frames allocated" "$WORK/$scenario-coroutines.log" | sed "s/^/$scenario       /"
+  packets=$(events_field $scenario-callbacks 4)
+  if [ -z "$packets" ] || [ "$packets" != "$(events_field $scenario-coroutines 4)" ]; then
+    echo "FAIL: $scenario receives a different number of packets with --coroutines"
+    status=1
+  fi
+done
+[ $status -eq 0 ] && echo "PASS: the coroutine applications build as C++20 and deliver what the callback versions do"
+exit $status
@@ -0,0 +1,62 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+#ifndef COUNTING_SCHEDULER_H
+#define COUNTING_SCHEDULER_H
+
+#include "ns3/core-module.h"
+
+namespace ns3 {
+
+/*
+ * MapScheduler (the default) that counts insertions. Every Simulator::Schedule
+ * and ScheduleNow call inserts once, whether or not the event is later
+ * cancelled, so this also sees events that never run, such as the TCP
+ * retransmission and delayed-ACK timers that get cancelled and rescheduled
+ * on every segment. Simulator::GetEventCount only counts events executed.
+ *
+ * Call CountingScheduler::Install () first thing in main.
+ */
+class CountingScheduler : public MapScheduler
+{
+public:
+  static TypeId GetTypeId (void)
+  {
+    static TypeId tid = TypeId ("ns3::CountingScheduler")
+      .SetParent<MapScheduler> ()
+      .SetGroupName ("Core")
+      .AddConstructor<CountingScheduler> ()
+    ;
+    return tid;
+  }
+
+  static void Install (void)
+  {
+    ObjectFactory factory;
+    factory.SetTypeId (GetTypeId ());
+    Simulator::SetScheduler (factory);
+  }
+
+  // events inserted so far, cancelled ones included
+  static uint64_t GetInserted (void)
+  {
+    return Inserted ();
+  }
+
+  virtual void Insert (const Event &ev)
+  {
+    Inserted ()++;
+    MapScheduler::Insert (ev);
+  }
+
+private:
+  static uint64_t &Inserted (void)
+  {
+    static uint64_t inserted = 0;
+    return inserted;
+  }
+};
+
+NS_OBJECT_ENSURE_REGISTERED (CountingScheduler);
+
+} // namespace ns3
+
+#endif /* COUNTING_SCHEDULER_H */
@@ -8,24 +8,52 @@
 #include "ns3/applications-module.h"
 #include "ns3/ipv4-global-routing-helper.h"
 #include "ns3/netanim-module.h"
+#include "checksum-pcap.h"
+#include "perf-report.h"
 
 using namespace ns3;
 
 NS_LOG_COMPONENT_DEFINE ("DhcpExample");
 
+// lease assignments are part of the golden output
+static void
+NewLease (PerfReport *report, std::string context, const Ipv4Address &address)
+{
+  std::ostringstream os;
+  os << "lease " << context << " " << address;
+  report->Record (os.str ());
+}
+
 int main (int argc, char *argv[])
 {
+  std::string checksum = "none";
+  PerfReport report;
+
   CommandLine cmd (__FILE__);
+  cmd.AddValue ("checksum", "Protocols to checksum in the pcap traces: ipv4,icmp,udp,tcp, all or none", checksum);
+  report.AddCommandLine (cmd);
   cmd.Parse (argc, argv);
+
+  // e.g. --checksum=udp gives DHCP and echo datagrams valid checksums in
+  // the captures without paying for them on every simulated header
+  uint32_t checksumProtocols;
+  if (!ParseChecksumProtocols (checksum, checksumProtocols))
+    {
+      std::cout << "unknown protocol in --checksum=" << checksum << std::endl;
+      return 1;
+    }
   
   // set time resolution
   Time::SetResolution (Time::NS);
   
-  // Enable logging for applications
-  LogComponentEnable ("DhcpServer", LOG_LEVEL_ALL);
-  LogComponentEnable ("DhcpClient", LOG_LEVEL_ALL);
-  LogComponentEnable ("UdpEchoServerApplication", LOG_LEVEL_INFO);
-  LogComponentEnable ("UdpEchoClientApplication", LOG_LEVEL_INFO);
+  // Enable logging for applications, except in timed runs
+  if (!report.IsBench ())
+    {
+      LogComponentEnable ("DhcpServer", LOG_LEVEL_ALL);
+      LogComponentEnable ("DhcpClient", LOG_LEVEL_ALL);
+      LogComponentEnable ("UdpEchoServerApplication", LOG_LEVEL_INFO);
+      LogComponentEnable ("UdpEchoClientApplication", LOG_LEVEL_INFO);
+    }
   
   //create nodes
   NS_LOG_INFO ("Create nodes.");
@@ -107,6 +135,7 @@ int main (int argc, char *argv[])
   dhcpClients.Start (Seconds (1.0));
   dhcpClients.Stop (Seconds (20.0));
   
+  
  // configure and install UdpEchoServer App on node A
   UdpEchoServerHelper echoServer (9); //port no
 
@@ -134,29 +163,48 @@ int main (int argc, char *argv[])
  //configure stop time of simulator
   Simulator::Stop (Seconds (30.0));
 
-  // capture packets on all nodes in bus topology
-  csma.EnablePcapAll ("dhcp-csma");
-  
-  // capture packets on p2p nodes
-  pointToPoint.EnablePcapAll ("dhcp-p2p");
-
-  // create animation object
-  AnimationInterface anim("dhcp.xml"); // specify the output filename
-
-  // set the attributes of animation
-  anim.SetConstantPosition(nodes.Get(0), 10, 10);
-  anim.SetConstantPosition(nodes.Get(1), 30, 10);
-  anim.SetConstantPosition(nodes.Get(2), 20, 30);
-  anim.SetConstantPosition(router.Get(0), 40, 10);
-  anim.SetConstantPosition(router.Get(1), 40, 30);
-  anim.SetConstantPosition(p2pNodes.Get(1), 50, 20);
+  Config::Connect ("/NodeList/*/ApplicationList/*/$ns3::DhcpClient/NewLease", MakeBoundCallback (&NewLease, &report));
+
+  // capture packets on all nodes in bus topology and on the p2p nodes, and
+  // animate the topology, except in timed runs
+  AnimationInterface *anim = 0;
+  if (!report.IsBench ())
+    {
+      if (checksumProtocols)
+        {
+          ChecksumPcapHelper checksumPcap (checksumProtocols);
+          checksumPcap.Enable ("dhcp-csma", devNet);
+          checksumPcap.Enable ("dhcp-p2p", p2pDevices);
+        }
+      else
+        {
+          csma.EnablePcapAll ("dhcp-csma");
+          pointToPoint.EnablePcapAll ("dhcp-p2p");
+        }
+      report.AddPcap ("dhcp-csma", devNet);
+      report.AddPcap ("dhcp-p2p", p2pDevices);
+
+      // create animation object
+      anim = new AnimationInterface ("dhcp.xml"); // specify the output filename
+
+      // set the attributes of animation
+      anim->SetConstantPosition(nodes.Get(0), 10, 10);
+      anim->SetConstantPosition(nodes.Get(1), 30, 10);
+      anim->SetConstantPosition(nodes.Get(2), 20, 30);
+      anim->SetConstantPosition(router.Get(0), 40, 10);
+      anim->SetConstantPosition(router.Get(1), 40, 30);
+      anim->SetConstantPosition(p2pNodes.Get(1), 50, 20);
+    }
 
 
   NS_LOG_INFO ("Run Simulation.");
+  report.Start (Seconds (30.0));
   Simulator::Run ();
+  report.Stop ();
   Simulator::Destroy ();
+  delete anim;
   NS_LOG_INFO ("Done.");
-  return 0;
+  return report.Finish () ? 0 : 1;
 }
  
  
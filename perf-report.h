@@ -0,0 +1,231 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+#ifndef PERF_REPORT_H
+#define PERF_REPORT_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/flow-monitor-module.h"
+#include <sys/resource.h>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+
+/*
+ * Run measurements and golden-output check shared by the scenario scripts.
+ *
+ * Every script reports wall time, executed events per second and peak RSS.
+ * With --digest the packet-level results (FlowMonitor stats, whatever the
+ * script records itself, and the pcap files it writes) are folded into one
+ * FNV-1a digest. --expectDigest fails the run when the digest differs, and
+ * --baselineEventsPerSec fails it when throughput drops more than
+ * --maxSlowdown below the saved baseline. --bench marks a timed run: scripts
+ * then leave out logging, pcap and NetAnim output, which would otherwise be
+ * timed along with the simulation.
+ *
+ * Use:
+ *   report.AddCommandLine (cmd);  before cmd.Parse
+ *   report.Start (stopTime);      just before Simulator::Run
+ *   report.Stop ();               just after Simulator::Run
+ *   return report.Finish () ? 0 : 1;  after Simulator::Destroy
+ */
+class PerfReport
+{
+public:
+  PerfReport ()
+    : m_digest (false),
+      m_bench (false),
+      m_baselineEventsPerSec (0.0),
+      m_maxSlowdown (0.1),
+      m_elapsed (0.0),
+      m_events (0)
+  {
+  }
+
+  void AddCommandLine (CommandLine &cmd)
+  {
+    cmd.AddValue ("digest", "Collect flow stats and pcap hashes and print the output digest", m_digest);
+    cmd.AddValue ("bench", "Timed run without logging, pcap or animation output", m_bench);
+    cmd.AddValue ("expectDigest", "Fail unless the output digest equals this value", m_expectDigest);
+    cmd.AddValue ("baselineEventsPerSec", "Saved events/s baseline to check throughput against (0 disables)", m_baselineEventsPerSec);
+    cmd.AddValue ("maxSlowdown", "Allowed fractional drop below the events/s baseline", m_maxSlowdown);
+  }
+
+  bool IsDigestEnabled (void) const
+  {
+    return m_digest || !m_expectDigest.empty ();
+  }
+
+  bool IsBench (void) const
+  {
+    return m_bench;
+  }
+
+  // fold a packet-level result into the digest
+  void Record (const std::string &line)
+  {
+    m_records.push_back (line);
+  }
+
+  // hash the pcap files this run writes under the prefix for these devices;
+  // pass exactly the devices given to EnablePcap, so a stale file left by an
+  // earlier run with other devices traced never gets into the digest
+  void AddPcap (const std::string &prefix, NetDeviceContainer devices)
+  {
+    for (NetDeviceContainer::Iterator i = devices.Begin (); i != devices.End (); ++i)
+      {
+        AddPcap (prefix, *i);
+      }
+  }
+
+  void AddPcap (const std::string &prefix, Ptr<NetDevice> device)
+  {
+    PcapHelper pcapHelper;
+    m_pcapFiles.push_back (pcapHelper.GetFilenameFromDevice (prefix, device));
+  }
+
+  void Start (Time stopTime)
+  {
+    if (IsDigestEnabled ())
+      {
+        // FlowMonitor keeps checking for lost packets, so the run needs an end
+        m_monitor = m_flowHelper.InstallAll ();
+        Simulator::Stop (stopTime);
+      }
+    m_start = std::chrono::steady_clock::now ();
+  }
+
+  void Stop (void)
+  {
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now () - m_start;
+    m_elapsed = elapsed.count ();
+    m_events = Simulator::GetEventCount ();
+    if (m_monitor)
+      {
+        m_monitor->CheckForLostPackets ();
+        Ptr<Ipv4FlowClassifier> classifier = DynamicCast<Ipv4FlowClassifier> (m_flowHelper.GetClassifier ());
+        const FlowMonitor::FlowStatsContainer &stats = m_monitor->GetFlowStats ();
+        for (FlowMonitor::FlowStatsContainer::const_iterator i = stats.begin (); i != stats.end (); ++i)
+          {
+            Ipv4FlowClassifier::FiveTuple t = classifier->FindFlow (i->first);
+            std::ostringstream os;
+            os << "flow " << i->first << " " << t.sourceAddress << ":" << t.sourcePort
+               << " " << t.destinationAddress << ":" << t.destinationPort << " proto " << (uint32_t) t.protocol
+               << " tx " << i->second.txPackets << "/" << i->second.txBytes
+               << " rx " << i->second.rxPackets << "/" << i->second.rxBytes
+               << " lost " << i->second.lostPackets
+               << " delay " << i->second.delaySum.GetNanoSeconds ();
+            Record (os.str ());
+          }
+      }
+  }
+
+  int64_t GetElapsedMs (void) const
+  {
+    return (int64_t) (m_elapsed * 1000);
+  }
+
+  // steady-clock wall time of the run, at the clock's full resolution
+  double GetElapsedSeconds (void) const
+  {
+    return m_elapsed;
+  }
+
+  // print the report and run the checks; false when any check fails
+  bool Finish (void)
+  {
+    struct rusage usage;
+    getrusage (RUSAGE_SELF, &usage);
+    double eventsPerSec = m_elapsed > 0 ? m_events / m_elapsed : 0.0;
+    std::cout << "Perf: wall " << GetElapsedMs () << " ms, events " << m_events
+              << ", " << (uint64_t) eventsPerSec << " events/s"
+              << ", peak RSS " << usage.ru_maxrss << " KiB" << std::endl;
+
+    bool ok = true;
+    if (IsDigestEnabled ())
+      {
+        // pcap files are only complete once Simulator::Destroy has closed them
+        for (std::vector<std::string>::const_iterator i = m_pcapFiles.begin (); i != m_pcapFiles.end (); ++i)
+          {
+            std::ifstream file (i->c_str (), std::ios::binary);
+            std::ostringstream os;
+            os << "pcap " << *i << " ";
+            if (file)
+              {
+                std::ostringstream contents;
+                contents << file.rdbuf ();
+                os << Hex (Fnv1a (contents.str (), FNV_OFFSET));
+              }
+            else
+              {
+                os << "missing";
+              }
+            Record (os.str ());
+          }
+
+        uint64_t hash = FNV_OFFSET;
+        for (std::vector<std::string>::const_iterator i = m_records.begin (); i != m_records.end (); ++i)
+          {
+            std::cout << "  " << *i << std::endl;
+            hash = Fnv1a (*i + "\n", hash);
+          }
+        std::string digest = Hex (hash);
+        std::cout << "Digest: " << digest << std::endl;
+        if (!m_expectDigest.empty () && digest != m_expectDigest)
+          {
+            std::cout << "FAIL: digest " << digest << " differs from expected " << m_expectDigest << std::endl;
+            ok = false;
+          }
+      }
+
+    if (m_baselineEventsPerSec > 0 && m_elapsed > 0
+        && eventsPerSec < m_baselineEventsPerSec * (1.0 - m_maxSlowdown))
+      {
+        std::cout << "FAIL: " << (uint64_t) eventsPerSec << " events/s is more than " << m_maxSlowdown * 100
+                  << "% below the baseline of " << (uint64_t) m_baselineEventsPerSec << std::endl;
+        ok = false;
+      }
+    return ok;
+  }
+
+private:
+  static const uint64_t FNV_OFFSET = 14695981039346656037ULL;
+
+  static uint64_t Fnv1a (const std::string &data, uint64_t hash)
+  {
+    for (std::string::const_iterator i = data.begin (); i != data.end (); ++i)
+      {
+        hash ^= (uint8_t) *i;
+        hash *= 1099511628211ULL;
+      }
+    return hash;
+  }
+
+  static std::string Hex (uint64_t value)
+  {
+    char buf[17];
+    std::snprintf (buf, sizeof (buf), "%016llx", (unsigned long long) value);
+    return buf;
+  }
+
+  bool m_digest;
+  bool m_bench;
+  std::string m_expectDigest;
+  double m_baselineEventsPerSec;
+  double m_maxSlowdown;
+  std::chrono::steady_clock::time_point m_start;
+  double m_elapsed;
+  uint64_t m_events;
+  FlowMonitorHelper m_flowHelper;
+  Ptr<FlowMonitor> m_monitor;
+  std::vector<std::string> m_records;
+  std::vector<std::string> m_pcapFiles;
+};
+
+} // namespace ns3
+
+#endif /* PERF_REPORT_H */
@@ -0,0 +1,174 @@
+#!/bin/sh
+# Performance regression suite for the six scenarios. Each case in the
+# goldens file runs twice:
+#   - a --digest run, which must reproduce the golden digest;
+#   - a --bench run, with logging, pcap and NetAnim output off, whose
+#     events/s must stay within the allowed slowdown of the baseline.
+# Wall time, events, events/s and peak RSS of the bench runs go to a CSV.
+#
+#   NS3_DIR=~/ns-3-dev ./perf-suite.sh [options] [case ...]
+#
+#   --goldens=FILE      cases and goldens (default perf-goldens.txt here)
+#   --results=FILE      CSV to write (default perf-results.csv)
+#   --maxSlowdown=F     allowed fractional drop in events/s (default 0.1)
+#   --runs=N            bench runs per case; the fastest counts (default 1)
+#   --update            record the digests and events/s as the new goldens
+#
+# Cases named on the command line run alone; otherwise all of them run. The
+# scenario scripts must be in $NS3_DIR/scratch and ns-3 built with
+# FlowMonitor. Every run gets a fresh working directory, so pcap files from
+# earlier runs never reach a digest.
+#
+# A case without a recorded digest or baseline is "unchecked". Outside
+# --update that fails the suite too: nothing was compared, so it cannot pass.
+
+NS3_DIR=${NS3_DIR:?set NS3_DIR to the ns-3 tree with these scripts in scratch/}
+GOLDENS=$(dirname "$0")/perf-goldens.txt
+RESULTS=perf-results.csv
+MAX_SLOWDOWN=0.1
+RUNS=1
+UPDATE=0
+CASES=""
+
+for arg in "$@"; do
+  case $arg in
+    --goldens=*) GOLDENS=${arg#*=} ;;
+    --results=*) RESULTS=${arg#*=} ;;
+    --maxSlowdown=*) MAX_SLOWDOWN=${arg#*=} ;;
+    --runs=*) RUNS=${arg#*=} ;;
+    --update) UPDATE=1 ;;
+    -*) echo "unknown option $arg"; exit 2 ;;
+    *) CASES="$CASES $arg" ;;
+  esac
+done
+
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+# run NAME COMMAND: run one scenario in its own directory, output in $WORK/NAME.log
+run ()
+{
+  rm -rf "$WORK/cwd"
+  mkdir "$WORK/cwd"
+  "$NS3_DIR/waf" --cwd="$WORK/cwd" --run "$2" < /dev/null > "$WORK/$1.log" 2>&1
+}
+
+# field N of "Perf: wall W ms, events E, R events/s, peak RSS K KiB"
+perf_field ()
+{
+  sed -n "s/^Perf: wall \([0-9]*\) ms, events \([0-9]*\), \([0-9]*\) events\/s, peak RSS \([0-9]*\) KiB.*/\\$2/p" "$WORK/$1.log"
+}
+
+digest_of ()
+{
+  sed -n 's/^Digest: \([0-9a-f]*\)$/\1/p' "$WORK/$1.log"
+}
+
+selected ()
+{
+  [ -z "$CASES" ] && return 0
+  for c in $CASES; do
+    [ "$c" = "$1" ] && return 0
+  done
+  return 1
+}
+
+echo "case,digest,digest status,wall ms,events,events/s,peak RSS KiB,perf status" > "$RESULTS"
+: > "$WORK/goldens"
+status=0
+failed=0
+unchecked=0
+
+while IFS= read -r line; do
+  case $line in
+    ''|'#'*)
+      printf '%s\n' "$line" >> "$WORK/goldens"
+      continue ;;
+  esac
+  IFS='|' read -r name command digest rate <<EOF
+$line
+EOF
+  if ! selected "$name"; then
+    printf '%s\n' "$line" >> "$WORK/goldens"
+    continue
+  fi
+
+  # packet-level output against the golden digest
+  expect=""
+  [ "$UPDATE" -eq 0 ] && [ "$digest" != "-" ] && expect="--expectDigest=$digest"
+  if run "$name-digest" "$command --digest $expect"; then
+    digestStatus=ok
+  else
+    digestStatus=FAIL
+  fi
+  newDigest=$(digest_of "$name-digest")
+  if [ -z "$newDigest" ]; then
+    digestStatus=FAIL
+  elif [ "$digestStatus" = ok ] && [ -z "$expect" ]; then
+    digestStatus=unchecked
+  fi
+
+  # timed runs against the saved events/s baseline
+  baseline=""
+  [ "$UPDATE" -eq 0 ] && [ "$rate" != "-" ] && baseline="--baselineEventsPerSec=$rate --maxSlowdown=$MAX_SLOWDOWN"
+  perfStatus=FAIL
+  best=""
+  i=0
+  while [ $i -lt "$RUNS" ]; do
+    i=$((i + 1))
+    run "$name-bench-$i" "$command --bench $baseline"
+    result=$?
+    eps=$(perf_field "$name-bench-$i" 3)
+    [ -z "$eps" ] && continue
+    if [ -z "$best" ] || [ "$eps" -gt "$(perf_field "$best" 3)" ]; then
+      best="$name-bench-$i"
+    fi
+    if [ $result -eq 0 ]; then
+      perfStatus=ok
+    fi
+  done
+  if [ -z "$best" ]; then
+    perfStatus=FAIL
+  elif [ "$perfStatus" = ok ] && [ -z "$baseline" ]; then
+    perfStatus=unchecked
+  fi
+
+  if [ "$digestStatus" = FAIL ] || [ "$perfStatus" = FAIL ]; then
+    status=1
+    failed=$((failed + 1))
+    for log in "$name-digest" "${best:-$name-bench-$RUNS}"; do
+      tail -n 5 "$WORK/$log.log" | sed "s/^/  $log: /"
+    done
+  elif [ "$UPDATE" -eq 0 ] && { [ "$digestStatus" = unchecked ] || [ "$perfStatus" = unchecked ]; }; then
+    status=1
+    unchecked=$((unchecked + 1))
+  fi
+
+  wall=$( [ -n "$best" ] && perf_field "$best" 1)
+  events=$( [ -n "$best" ] && perf_field "$best" 2)
+  eps=$( [ -n "$best" ] && perf_field "$best" 3)
+  rss=$( [ -n "$best" ] && perf_field "$best" 4)
+  printf '%-16s digest %-9s %s  perf %-9s %s ms, %s events, %s events/s, %s KiB\n' \
+    "$name" "$digestStatus" "${newDigest:--}" "$perfStatus" "${wall:--}" "${events:--}" "${eps:--}" "${rss:--}"
+  printf '%s,%s,%s,%s,%s,%s,%s,%s\n' \
+    "$name" "$newDigest" "$digestStatus" "$wall" "$events" "$eps" "$rss" "$perfStatus" >> "$RESULTS"
+
+  if [ "$UPDATE" -eq 1 ]; then
+    printf '%s|%s|%s|%s\n' "$name" "$command" "${newDigest:--}" "${eps:--}" >> "$WORK/goldens"
+  else
+    printf '%s\n' "$line" >> "$WORK/goldens"
+  fi
+done < "$GOLDENS"
+
+if [ "$UPDATE" -eq 1 ]; then
+  cp "$WORK/goldens" "$GOLDENS"
+  echo "Goldens written to $GOLDENS"
+fi
+if [ $failed -gt 0 ]; then
+  echo "FAIL: $failed cases failed, see above"
+elif [ $unchecked -gt 0 ]; then
+  echo "UNCHECKED: $unchecked cases have no recorded goldens; record them with --update"
+elif [ "$UPDATE" -eq 0 ]; then
+  echo "PASS: all cases match their goldens"
+fi
+exit $status
@@ -8,11 +8,177 @@
 #include "ns3/point-to-point-module.h"
 #include "ns3/applications-module.h"
 #include "ns3/point-to-point-layout-module.h"
+#include "checksum-pcap.h"
+#include "counting-scheduler.h"
+#include "coroutine-application.h"
+#include "perf-report.h"
+#include <iomanip>
+#include <list>
 
 using namespace ns3;
 
 NS_LOG_COMPONENT_DEFINE ("Star");
 
+// packets delivered to the hub sink, used to report per-packet cost
+static uint64_t g_received = 0;
+
+static void
+HubRx (Ptr<const Packet> packet, const Address &from)
+{
+  g_received++;
+}
+
+#ifdef NS3_COROUTINES
+// PacketSink as coroutines: one per accepted TCP connection
+class CoPacketSink : public Application
+{
+public:
+  static TypeId GetTypeId (void)
+  {
+    static TypeId tid = TypeId ("ns3::CoPacketSink")
+      .SetParent<Application> ()
+      .AddConstructor<CoPacketSink> ()
+      .AddTraceSource ("Rx", "A packet has been received",
+                       MakeTraceSourceAccessor (&CoPacketSink::m_rxTrace),
+                       "ns3::Packet::AddressTracedCallback")
+    ;
+    return tid;
+  }
+
+  void SetLocal (Address local)
+  {
+    m_local = local;
+  }
+
+protected:
+  virtual void DoDispose (void)
+  {
+    m_readers.clear ();
+    m_socket = 0;
+    m_peers.clear ();
+    Application::DoDispose ();
+  }
+
+private:
+  virtual void StartApplication (void)
+  {
+    m_socket = Socket::CreateSocket (GetNode (), TcpSocketFactory::GetTypeId ());
+    m_socket->Bind (m_local);
+    m_socket->Listen ();
+    m_socket->SetAcceptCallback (MakeNullCallback<bool, Ptr<Socket>, const Address &> (),
+                                 MakeCallback (&CoPacketSink::Accept, this));
+  }
+
+  virtual void StopApplication (void)
+  {
+    m_readers.clear ();
+    for (std::list<Ptr<Socket> >::iterator i = m_peers.begin (); i != m_peers.end (); ++i)
+      {
+        (*i)->Close ();
+      }
+    m_socket->Close ();
+  }
+
+  void Accept (Ptr<Socket> socket, const Address &from)
+  {
+    m_peers.push_back (socket);
+    m_readers.push_back (Read (socket));
+  }
+
+  CoTask Read (Ptr<Socket> socket)
+  {
+    for (;;)
+      {
+        Address from;
+        Ptr<Packet> packet = co_await CoRecvFrom (socket, from);
+        if (packet && packet->GetSize () > 0)
+          {
+            m_rxTrace (packet, from);
+          }
+      }
+  }
+
+  Address m_local;
+  Ptr<Socket> m_socket;
+  std::list<Ptr<Socket> > m_peers;
+  std::list<CoTask> m_readers;
+  TracedCallback<Ptr<const Packet>, const Address &> m_rxTrace;
+};
+
+// always-on OnOffApplication as a coroutine: connect, then send a packet
+// every size/rate seconds while the TCP buffer has room
+class CoOnOff : public Application
+{
+public:
+  static TypeId GetTypeId (void)
+  {
+    static TypeId tid = TypeId ("ns3::CoOnOff")
+      .SetParent<Application> ()
+      .AddConstructor<CoOnOff> ()
+    ;
+    return tid;
+  }
+
+  CoOnOff ()
+    : m_size (512)
+  {
+  }
+
+  void Setup (Address remote, uint32_t size, DataRate rate)
+  {
+    m_remote = remote;
+    m_size = size;
+    m_rate = rate;
+  }
+
+protected:
+  virtual void DoDispose (void)
+  {
+    m_task.Destroy ();
+    m_socket = 0;
+    Application::DoDispose ();
+  }
+
+private:
+  virtual void StartApplication (void)
+  {
+    m_socket = Socket::CreateSocket (GetNode (), TcpSocketFactory::GetTypeId ());
+    m_socket->Bind ();
+    m_socket->Connect (m_remote);
+    m_socket->ShutdownRecv ();
+    m_task = Send ();
+  }
+
+  virtual void StopApplication (void)
+  {
+    m_task.Destroy ();
+    m_socket->Close ();
+  }
+
+  CoTask Send (void)
+  {
+    bool connected = co_await CoConnected (m_socket);
+    if (!connected)
+      {
+        co_return;
+      }
+    Time gap = m_rate.CalculateBytesTxTime (m_size);
+    for (;;)
+      {
+        co_await CoWritable (m_socket, m_size);
+        m_socket->Send (Create<Packet> (m_size));
+        co_await CoDelay (gap);
+      }
+  }
+
+  Address m_remote;
+  uint32_t m_size;
+  DataRate m_rate;
+  Ptr<Socket> m_socket;
+  CoTask m_task;
+};
+#endif
+
 int main (int argc, char *argv[])
 {
    // setting the default values
@@ -23,9 +189,33 @@ int main (int argc, char *argv[])
  
   // Specify number of spoke nodes
   uint32_t nSpokes = 8;
+  std::string checksum = "none";
+  bool coroutines = false;
+  PerfReport report;
   
   CommandLine cmd (__FILE__);
+  cmd.AddValue ("nSpokes", "Number of spoke nodes around the hub", nSpokes);
+  cmd.AddValue ("checksum", "Protocols to checksum in the pcap traces: ipv4,icmp,udp,tcp, all or none", checksum);
+  cmd.AddValue ("coroutines", "Run the hub sink and spoke senders as coroutine applications (C++20 builds)", coroutines);
+  report.AddCommandLine (cmd);
   cmd.Parse (argc, argv);
+
+  // the spokes send 137-byte TCP segments; --checksum=tcp fills in just
+  // their checksums as the traces are written
+  uint32_t checksumProtocols;
+  if (!ParseChecksumProtocols (checksum, checksumProtocols))
+    {
+      std::cout << "unknown protocol in --checksum=" << checksum << std::endl;
+      return 1;
+    }
+#ifndef NS3_COROUTINES
+  if (coroutines)
+    {
+      std::cout << "--coroutines needs ns-3 built as C++20" << std::endl;
+      return 1;
+    }
+#endif
+  CountingScheduler::Install ();
   
   //configuring point to point net devices and channel between hub and spoke nodes
   
@@ -44,6 +234,7 @@ int main (int argc, char *argv[])
   // Assigning the ip addresses to spoke nodes and hub
   star.AssignIpv4Addresses (Ipv4AddressHelper ("10.0.0.0", "255.0.0.0"));
   
+  
   // to get the ip address of interface 0 of hub
   NS_LOG_INFO("Address of Hub: " << star.GetHubIpv4Address(0));
   
@@ -63,7 +254,20 @@ int main (int argc, char *argv[])
   PacketSinkHelper packetSinkHelper ("ns3::TcpSocketFactory", hubLocalAddress);
   
   //install Packet Sink Application on Hub
-  ApplicationContainer hubApp = packetSinkHelper.Install (star.GetHub ());
+  ApplicationContainer hubApp;
+  if (coroutines)
+    {
+#ifdef NS3_COROUTINES
+      Ptr<CoPacketSink> sink = CreateObject<CoPacketSink> ();
+      sink->SetLocal (hubLocalAddress);
+      star.GetHub ()->AddApplication (sink);
+      hubApp.Add (sink);
+#endif
+    }
+  else
+    {
+      hubApp = packetSinkHelper.Install (star.GetHub ());
+    }
   
   hubApp.Start (Seconds (1.0));
   hubApp.Stop (Seconds (10.0));
@@ -85,8 +289,21 @@ int main (int argc, char *argv[])
       
       NS_LOG_INFO("remote: " << star.GetHubIpv4Address(i));
       
-      onOffHelper.SetAttribute ("Remote", remoteAddress);
-      spokeApps.Add (onOffHelper.Install (star.GetSpokeNode (i)));
+      if (coroutines)
+        {
+#ifdef NS3_COROUTINES
+          // same packet size and rate as the OnOffApplication defaults set above
+          Ptr<CoOnOff> sender = CreateObject<CoOnOff> ();
+          sender->Setup (remoteAddress.Get (), 137, DataRate ("14kb/s"));
+          star.GetSpokeNode (i)->AddApplication (sender);
+          spokeApps.Add (sender);
+#endif
+        }
+      else
+        {
+          onOffHelper.SetAttribute ("Remote", remoteAddress);
+          spokeApps.Add (onOffHelper.Install (star.GetSpokeNode (i)));
+        }
       NS_LOG_INFO("remote: " << star.GetSpokeNode(i));
     }
   
@@ -99,18 +316,78 @@ int main (int argc, char *argv[])
   
   Ipv4GlobalRoutingHelper::PopulateRoutingTables ();  
   
-  pointToPoint.EnablePcapAll ("star");
-  
-  // Animating star topology
-  AnimationInterface anim ("hus_star.xml");
-  star.BoundingBox (1, 1, 100, 100);
+  // capture every spoke link, both ends, and animate the star, except in
+  // timed runs
+  AnimationInterface *anim = 0;
+  if (!report.IsBench ())
+    {
+      NetDeviceContainer spokeLinks;
+      for (uint32_t i = 0; i < star.SpokeCount (); ++i)
+        {
+          spokeLinks.Add (star.GetHub ()->GetDevice (i));
+          spokeLinks.Add (star.GetSpokeNode (i)->GetDevice (0));
+        }
+      if (checksumProtocols)
+        {
+          ChecksumPcapHelper checksumPcap (checksumProtocols);
+          checksumPcap.Enable ("star", spokeLinks);
+        }
+      else
+        {
+          pointToPoint.EnablePcap ("star", spokeLinks);
+        }
+      report.AddPcap ("star", spokeLinks);
+  
+      // Animating star topology
+      anim = new AnimationInterface ("hus_star.xml");
+      star.BoundingBox (1, 1, 100, 100);
+    }
   
+  hubApp.Get (0)->TraceConnectWithoutContext ("Rx", MakeCallback (&HubRx));
   
+  report.Start (Seconds (10.0));
   Simulator::Run ();
+  report.Stop ();
+  
+  // TCP reschedules its retransmission and delayed-ACK timers on nearly
+  // every segment and cancels most of them, so far more events are
+  // scheduled than ever run. Each insert allocates a node in the scheduler's
+  // map; only the event objects are saved by coroutine delays, which reuse
+  // theirs
+  uint64_t scheduled = CountingScheduler::GetInserted ();
+  uint64_t reused = 0;
+#ifdef NS3_COROUTINES
+  reused = GetCoStats ().delaysScheduled;
+#endif
+  std::cout << "Events scheduled " << scheduled << ", event objects created " << scheduled - reused
+            << ", executed " << Simulator::GetEventCount () << ", packets " << g_received
+            << ", wall " << report.GetElapsedMs () << " ms";
+  if (g_received > 0)
+    {
+      std::cout << std::setprecision (3)
+                << ", " << (double) scheduled / g_received << " scheduled events/packet"
+                << ", " << (double) (scheduled - reused) / g_received << " event objects/packet"
+                << ", " << report.GetElapsedSeconds () * 1e6 / g_received << " us wall/packet"
+                << std::setprecision (6);
+    }
+  std::cout << std::endl;
+#ifdef NS3_COROUTINES
+  if (coroutines)
+    {
+      std::cout << "Coroutine frames allocated " << GetCoStats ().framesAllocated
+                << ", reused " << GetCoStats ().framesReused << std::endl;
+    }
+#endif
+  
+  std::ostringstream received;
+  received << "hub received " << g_received;
+  report.Record (received.str ());
+  
   Simulator::Destroy ();
+  delete anim;
   NS_LOG_INFO ("Done.");
 
-  return 0;
+  return report.Finish () ? 0 : 1;
 }
   
   
@@ -7,21 +7,605 @@
 #include "ns3/point-to-point-module.h"
 #include "ns3/applications-module.h"
 #include "ns3/netanim-module.h"
+#include "perf-report.h"
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <net/if.h>
+#include <linux/if_packet.h>
+#include <net/ethernet.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
 
  
 using namespace ns3;
 
 NS_LOG_COMPONENT_DEFINE ("UDPCSExample");
 
+/*
+ * DIX ethernet device bridged to a file descriptor: one end of a socketpair
+ * or a packet socket bound to a local device. Unlike FdNetDevice, which
+ * makes one read () and one simulator event per frame, frames are read with
+ * recvmmsg () and written with sendmmsg () in batches, so the syscall and
+ * cross-thread scheduling cost is paid once per batch. All frame buffers are
+ * allocated when the device starts; the reader thread and the simulator pass
+ * whole receive batches back and forth through a free list.
+ */
+class BatchFdNetDevice : public NetDevice
+{
+public:
+  static TypeId GetTypeId (void);
+
+  BatchFdNetDevice ();
+
+  // the device owns the descriptor from here on and closes it on dispose
+  void SetFileDescriptor (int fd);
+  void SetBatchSize (uint32_t frames);
+  void Start (void);
+
+  uint64_t GetRxFrames (void) const { return m_rxFrames; }
+  uint64_t GetRxBatches (void) const { return m_rxBatches; }
+  uint64_t GetTxFrames (void) const { return m_txFrames; }
+  uint64_t GetTxCalls (void) const { return m_txCalls; }
+  uint64_t GetTxDropped (void) const { return m_txDropped; }
+  bool IsPeerClosed (void) const { return m_peerClosed; }
+
+  virtual void SetIfIndex (const uint32_t index) { m_ifIndex = index; }
+  virtual uint32_t GetIfIndex (void) const { return m_ifIndex; }
+  virtual Ptr<Channel> GetChannel (void) const { return 0; }
+  virtual void SetAddress (Address address) { m_address = Mac48Address::ConvertFrom (address); }
+  virtual Address GetAddress (void) const { return m_address; }
+  virtual bool SetMtu (const uint16_t mtu) { m_mtu = mtu; return true; }
+  virtual uint16_t GetMtu (void) const { return m_mtu; }
+  virtual bool IsLinkUp (void) const { return true; }
+  virtual void AddLinkChangeCallback (Callback<void> callback) {}
+  virtual bool IsBroadcast (void) const { return true; }
+  virtual Address GetBroadcast (void) const { return Mac48Address ("ff:ff:ff:ff:ff:ff"); }
+  virtual bool IsMulticast (void) const { return true; }
+  virtual Address GetMulticast (Ipv4Address multicastGroup) const { return Mac48Address::GetMulticast (multicastGroup); }
+  virtual Address GetMulticast (Ipv6Address addr) const { return Mac48Address::GetMulticast (addr); }
+  virtual bool IsPointToPoint (void) const { return false; }
+  virtual bool IsBridge (void) const { return false; }
+  virtual bool Send (Ptr<Packet> packet, const Address &dest, uint16_t protocolNumber);
+  virtual bool SendFrom (Ptr<Packet> packet, const Address &source, const Address &dest, uint16_t protocolNumber);
+  virtual Ptr<Node> GetNode (void) const { return m_node; }
+  virtual void SetNode (Ptr<Node> node) { m_node = node; }
+  virtual bool NeedsArp (void) const { return true; }
+  virtual void SetReceiveCallback (NetDevice::ReceiveCallback cb) { m_rxCallback = cb; }
+  virtual void SetPromiscReceiveCallback (NetDevice::PromiscReceiveCallback cb) { m_promiscRxCallback = cb; }
+  virtual bool SupportsSendFrom (void) const { return true; }
+
+protected:
+  virtual void DoDispose (void);
+
+private:
+  // frames up to this size (a full 1500 byte MTU frame plus headers) fit a slot
+  static const uint32_t SLOT_SIZE = 2048;
+  // batches the reader can fill while the simulator is still busy with others
+  static const uint32_t RX_BATCHES = 4;
+
+  struct Batch
+  {
+    std::vector<uint8_t> slots;
+    std::vector<struct iovec> iovs;
+    std::vector<struct mmsghdr> msgs;
+    uint32_t count;
+  };
+
+  void InitBatch (Batch &batch);
+  void ReadLoop (void);
+  void ReceiveBatch (Batch *batch);
+  void ForwardUp (Ptr<Packet> packet);
+  void Flush (void);
+  void StopReader (void);
+
+  Ptr<Node> m_node;
+  uint32_t m_ifIndex;
+  Mac48Address m_address;
+  uint16_t m_mtu;
+  int m_fd;
+  uint32_t m_batchSize;
+  bool m_started;
+
+  std::vector<Batch> m_rx;
+  std::vector<Batch *> m_free;
+  std::mutex m_mutex;
+  std::condition_variable m_freeCondition;
+  bool m_stopping;
+  int m_stopPipe[2];
+  std::thread m_reader;
+
+  Batch m_tx;
+  EventId m_flushEvent;
+
+  NetDevice::ReceiveCallback m_rxCallback;
+  NetDevice::PromiscReceiveCallback m_promiscRxCallback;
+  TracedCallback<Ptr<const Packet> > m_macTxTrace;
+  TracedCallback<Ptr<const Packet> > m_macTxDropTrace;
+  TracedCallback<Ptr<const Packet> > m_macRxTrace;
+
+  uint64_t m_rxFrames;
+  uint64_t m_rxBatches;
+  uint64_t m_txFrames;
+  uint64_t m_txCalls;
+  uint64_t m_txDropped;
+  std::atomic<bool> m_peerClosed;
+};
+
+NS_OBJECT_ENSURE_REGISTERED (BatchFdNetDevice);
+
+TypeId
+BatchFdNetDevice::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::BatchFdNetDevice")
+    .SetParent<NetDevice> ()
+    .SetGroupName ("Network")
+    .AddConstructor<BatchFdNetDevice> ()
+    .AddTraceSource ("MacTx", "A packet has been queued for the next sendmmsg batch",
+                     MakeTraceSourceAccessor (&BatchFdNetDevice::m_macTxTrace),
+                     "ns3::Packet::TracedCallback")
+    .AddTraceSource ("MacTxDrop", "A packet was too large for a frame slot",
+                     MakeTraceSourceAccessor (&BatchFdNetDevice::m_macTxDropTrace),
+                     "ns3::Packet::TracedCallback")
+    .AddTraceSource ("MacRx", "A frame from a recvmmsg batch is passed up the stack",
+                     MakeTraceSourceAccessor (&BatchFdNetDevice::m_macRxTrace),
+                     "ns3::Packet::TracedCallback")
+  ;
+  return tid;
+}
+
+BatchFdNetDevice::BatchFdNetDevice ()
+  : m_ifIndex (0),
+    m_mtu (1500),
+    m_fd (-1),
+    m_batchSize (32),
+    m_started (false),
+    m_stopping (false),
+    m_rxFrames (0),
+    m_rxBatches (0),
+    m_txFrames (0),
+    m_txCalls (0),
+    m_txDropped (0),
+    m_peerClosed (false)
+{
+  m_stopPipe[0] = m_stopPipe[1] = -1;
+  m_tx.count = 0;
+}
+
+void
+BatchFdNetDevice::SetFileDescriptor (int fd)
+{
+  m_fd = fd;
+}
+
+void
+BatchFdNetDevice::SetBatchSize (uint32_t frames)
+{
+  NS_ABORT_MSG_IF (m_started, "batch size must be set before the device starts");
+  m_batchSize = std::max<uint32_t> (frames, 1);
+}
+
+void
+BatchFdNetDevice::InitBatch (Batch &batch)
+{
+  batch.slots.resize (m_batchSize * SLOT_SIZE);
+  batch.iovs.resize (m_batchSize);
+  batch.msgs.resize (m_batchSize);
+  std::memset (&batch.msgs[0], 0, m_batchSize * sizeof (struct mmsghdr));
+  for (uint32_t i = 0; i < m_batchSize; ++i)
+    {
+      batch.iovs[i].iov_base = &batch.slots[i * SLOT_SIZE];
+      batch.iovs[i].iov_len = SLOT_SIZE;
+      batch.msgs[i].msg_hdr.msg_iov = &batch.iovs[i];
+      batch.msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+  batch.count = 0;
+}
+
+void
+BatchFdNetDevice::Start (void)
+{
+  NS_ABORT_MSG_IF (m_fd < 0, "no file descriptor to bridge");
+  // a stream socket would merge and split frames; descriptors that are not
+  // sockets (e.g. a tap device) keep frame boundaries
+  int type;
+  socklen_t typeLength = sizeof (type);
+  NS_ABORT_MSG_IF (getsockopt (m_fd, SOL_SOCKET, SO_TYPE, &type, &typeLength) == 0 && type == SOCK_STREAM,
+                   "the bridged descriptor must keep frame boundaries (SOCK_DGRAM, SOCK_SEQPACKET or a packet socket), not SOCK_STREAM");
+  // writes must never block the simulator; a full socket buffer drops the rest of a batch
+  fcntl (m_fd, F_SETFL, fcntl (m_fd, F_GETFL) | O_NONBLOCK);
+  NS_ABORT_MSG_IF (pipe (m_stopPipe) < 0, "cannot create the reader stop pipe");
+
+  m_rx.resize (RX_BATCHES);
+  for (uint32_t i = 0; i < RX_BATCHES; ++i)
+    {
+      InitBatch (m_rx[i]);
+      m_free.push_back (&m_rx[i]);
+    }
+  InitBatch (m_tx);
+  m_started = true;
+  m_reader = std::thread (&BatchFdNetDevice::ReadLoop, this);
+}
+
+void
+BatchFdNetDevice::ReadLoop (void)
+{
+  struct pollfd fds[2];
+  fds[0].fd = m_fd;
+  fds[0].events = POLLIN;
+  fds[1].fd = m_stopPipe[0];
+  fds[1].events = POLLIN;
+
+  for (;;)
+    {
+      Batch *batch;
+      {
+        std::unique_lock<std::mutex> lock (m_mutex);
+        while (m_free.empty () && !m_stopping)
+          {
+            m_freeCondition.wait (lock);
+          }
+        if (m_stopping)
+          {
+            return;
+          }
+        batch = m_free.back ();
+        m_free.pop_back ();
+      }
+
+      int n = -1;
+      while (n < 0)
+        {
+          if (poll (fds, 2, -1) < 0 && errno != EINTR)
+            {
+              return;
+            }
+          if (fds[1].revents & POLLIN)
+            {
+              return;
+            }
+          if (!(fds[0].revents & POLLIN) && (fds[0].revents & (POLLHUP | POLLERR)))
+            {
+              // the other end has gone away and nothing is left to read
+              m_peerClosed = true;
+              return;
+            }
+          n = recvmmsg (m_fd, &batch->msgs[0], m_batchSize, MSG_DONTWAIT, 0);
+          if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+            {
+              return;
+            }
+        }
+
+      // once the peer of a SOCK_SEQPACKET socketpair closes, every read
+      // returns zero-length messages after the last real frame; no ethernet
+      // frame is empty, so the first one marks the end of the stream
+      int frames = 0;
+      while (frames < n && batch->msgs[frames].msg_len > 0)
+        {
+          frames++;
+        }
+      if (frames > 0)
+        {
+          // one cross-thread event for the whole batch
+          batch->count = frames;
+          Simulator::ScheduleWithContext (m_node->GetId (), Time (0), &BatchFdNetDevice::ReceiveBatch, this, batch);
+        }
+      if (frames < n || n == 0)
+        {
+          m_peerClosed = true;
+          return;
+        }
+    }
+}
+
+void
+BatchFdNetDevice::ReceiveBatch (Batch *batch)
+{
+  m_rxBatches++;
+  for (uint32_t i = 0; i < batch->count; ++i)
+    {
+      if (batch->msgs[i].msg_hdr.msg_flags & MSG_TRUNC)
+        {
+          continue;
+        }
+      m_rxFrames++;
+      ForwardUp (Create<Packet> (&batch->slots[i * SLOT_SIZE], batch->msgs[i].msg_len));
+    }
+
+  {
+    std::unique_lock<std::mutex> lock (m_mutex);
+    m_free.push_back (batch);
+  }
+  m_freeCondition.notify_one ();
+}
+
+void
+BatchFdNetDevice::ForwardUp (Ptr<Packet> packet)
+{
+  EthernetHeader header (false);
+  if (packet->GetSize () < header.GetSerializedSize ())
+    {
+      return;
+    }
+  packet->RemoveHeader (header);
+  Mac48Address destination = header.GetDestination ();
+  Mac48Address source = header.GetSource ();
+  uint16_t protocol = header.GetLengthType ();
+  if (protocol < 1536)
+    {
+      // 802.3 length field: LLC frames are not bridged
+      return;
+    }
+
+  PacketType packetType;
+  if (destination.IsBroadcast ())
+    {
+      packetType = NS3_PACKET_BROADCAST;
+    }
+  else if (destination.IsGroup ())
+    {
+      packetType = NS3_PACKET_MULTICAST;
+    }
+  else if (destination == m_address)
+    {
+      packetType = NS3_PACKET_HOST;
+    }
+  else
+    {
+      packetType = NS3_PACKET_OTHERHOST;
+    }
+
+  if (!m_promiscRxCallback.IsNull ())
+    {
+      m_promiscRxCallback (this, packet, protocol, source, destination, packetType);
+    }
+  if (packetType != NS3_PACKET_OTHERHOST)
+    {
+      m_macRxTrace (packet);
+      m_rxCallback (this, packet, protocol, source);
+    }
+}
+
+bool
+BatchFdNetDevice::Send (Ptr<Packet> packet, const Address &dest, uint16_t protocolNumber)
+{
+  return SendFrom (packet, m_address, dest, protocolNumber);
+}
+
+bool
+BatchFdNetDevice::SendFrom (Ptr<Packet> packet, const Address &source, const Address &dest, uint16_t protocolNumber)
+{
+  EthernetHeader header (false);
+  if (!m_started || packet->GetSize () + header.GetSerializedSize () > SLOT_SIZE)
+    {
+      m_macTxDropTrace (packet);
+      return false;
+    }
+  m_macTxTrace (packet);
+  header.SetSource (Mac48Address::ConvertFrom (source));
+  header.SetDestination (Mac48Address::ConvertFrom (dest));
+  header.SetLengthType (protocolNumber);
+  packet->AddHeader (header);
+
+  if (m_tx.count == m_batchSize)
+    {
+      Flush ();
+    }
+  uint32_t slot = m_tx.count++;
+  m_tx.iovs[slot].iov_len = packet->CopyData (&m_tx.slots[slot * SLOT_SIZE], SLOT_SIZE);
+
+  // everything sent in this time step goes out in one sendmmsg
+  if (!m_flushEvent.IsRunning ())
+    {
+      m_flushEvent = Simulator::ScheduleNow (&BatchFdNetDevice::Flush, this);
+    }
+  return true;
+}
+
+void
+BatchFdNetDevice::Flush (void)
+{
+  uint32_t sent = 0;
+  while (sent < m_tx.count)
+    {
+      int n = sendmmsg (m_fd, &m_tx.msgs[sent], m_tx.count - sent, 0);
+      if (n < 0)
+        {
+          if (errno == EINTR)
+            {
+              continue;
+            }
+          // socket buffer full or peer gone: the rest of the batch is lost, as on a real NIC
+          m_txDropped += m_tx.count - sent;
+          break;
+        }
+      m_txCalls++;
+      m_txFrames += n;
+      sent += n;
+    }
+  m_tx.count = 0;
+}
+
+void
+BatchFdNetDevice::StopReader (void)
+{
+  {
+    std::unique_lock<std::mutex> lock (m_mutex);
+    m_stopping = true;
+  }
+  m_freeCondition.notify_all ();
+  if (m_stopPipe[1] >= 0 && write (m_stopPipe[1], "x", 1) < 0)
+    {
+      NS_LOG_WARN ("cannot wake the reader thread");
+    }
+  if (m_reader.joinable ())
+    {
+      m_reader.join ();
+    }
+  for (int i = 0; i < 2; ++i)
+    {
+      if (m_stopPipe[i] >= 0)
+        {
+          close (m_stopPipe[i]);
+          m_stopPipe[i] = -1;
+        }
+    }
+}
+
+void
+BatchFdNetDevice::DoDispose (void)
+{
+  m_flushEvent.Cancel ();
+  StopReader ();
+  if (m_fd >= 0)
+    {
+      close (m_fd);
+      m_fd = -1;
+    }
+  m_node = 0;
+  m_rxCallback.Nullify ();
+  m_promiscRxCallback.Nullify ();
+  NetDevice::DoDispose ();
+}
+
+// raw packet socket on a local device (e.g. a veth end), in promiscuous mode
+static int
+OpenPacketSocket (const std::string &device)
+{
+  int fd = socket (AF_PACKET, SOCK_RAW, htons (ETH_P_ALL));
+  if (fd < 0)
+    {
+      return -1;
+    }
+  struct sockaddr_ll ll;
+  std::memset (&ll, 0, sizeof (ll));
+  ll.sll_family = AF_PACKET;
+  ll.sll_protocol = htons (ETH_P_ALL);
+  ll.sll_ifindex = if_nametoindex (device.c_str ());
+  struct packet_mreq mreq;
+  std::memset (&mreq, 0, sizeof (mreq));
+  mreq.mr_ifindex = ll.sll_ifindex;
+  mreq.mr_type = PACKET_MR_PROMISC;
+  if (ll.sll_ifindex == 0
+      || bind (fd, (struct sockaddr *) &ll, sizeof (ll)) < 0
+      || setsockopt (fd, SOL_PACKET, PACKET_ADD_MEMBERSHIP, &mreq, sizeof (mreq)) < 0)
+    {
+      close (fd);
+      return -1;
+    }
+#ifdef PACKET_IGNORE_OUTGOING
+  // don't read back the frames we send ourselves
+  int one = 1;
+  setsockopt (fd, SOL_PACKET, PACKET_IGNORE_OUTGOING, &one, sizeof (one));
+#endif
+  return fd;
+}
+
+// Real-time scheduling lag, i.e. how far the wall clock has run ahead of
+// simulation time when an event is executed.
+static Time g_lagMax;
+static Time g_lagSum;
+static uint64_t g_lagSamples = 0;
+static uint64_t g_lagLate = 0;
+static Time g_lagWarn;
+
+static void
+RecordRealtimeLag (void)
+{
+  Ptr<RealtimeSimulatorImpl> impl = DynamicCast<RealtimeSimulatorImpl> (Simulator::GetImplementation ());
+  Time lag = impl->RealtimeNow () - Simulator::Now ();
+  g_lagSum += lag;
+  g_lagSamples++;
+  if (lag > g_lagMax)
+    {
+      g_lagMax = lag;
+    }
+  if (lag > g_lagWarn)
+    {
+      g_lagLate++;
+    }
+}
+
+static void
+SampleRealtimeLag (Time interval)
+{
+  RecordRealtimeLag ();
+  Simulator::Schedule (interval, &SampleRealtimeLag, interval);
+}
+
+// every frame read from the emulated link is also a lag sample
+static void
+EmuRx (Ptr<const Packet> packet)
+{
+  RecordRealtimeLag ();
+}
+
 int
 main (int argc, char *argv[])
 {
+  // emulation settings; the link is only bridged when a descriptor or device is given
+  int emuFd = -1;
+  std::string emuDevice = "";
+  uint32_t emuBatch = 32;
+  double lagInterval = 0.01;
+  double lagWarn = 0.001;
+  double stopTime = 10.0;
+  uint32_t nPackets = 1;
+  double interval = 1.0;
+  PerfReport report;
+
   CommandLine cmd (__FILE__);
+  cmd.AddValue ("nPackets", "Number of packets sent by the udp client", nPackets);
+  cmd.AddValue ("interval", "Interval in seconds between udp client packets", interval);
+  cmd.AddValue ("emuFd", "Inherited descriptor (e.g. one end of a socketpair) to bridge node 0 to", emuFd);
+  cmd.AddValue ("emuDevice", "Local device (e.g. a veth end) to bridge node 0 to", emuDevice);
+  cmd.AddValue ("emuBatch", "Frames per recvmmsg/sendmmsg call on the emulated link", emuBatch);
+  cmd.AddValue ("lagInterval", "Real-time lag sampling interval in seconds", lagInterval);
+  cmd.AddValue ("lagWarn", "Count lag samples above this many seconds as late", lagWarn);
+  cmd.AddValue ("stopTime", "Simulation and application stop time in seconds when emulating", stopTime);
+  report.AddCommandLine (cmd);
   cmd.Parse (argc, argv);
+
+  bool emulate = (emuFd >= 0 || !emuDevice.empty ());
+  if (emuFd >= 0 && !emuDevice.empty ())
+    {
+      std::cout << "emuFd and emuDevice are mutually exclusive" << std::endl;
+      return 1;
+    }
+  // a zero interval would resample at the same instant forever
+  if (emulate && (lagInterval <= 0 || stopTime <= 0))
+    {
+      std::cout << "lagInterval and stopTime must be positive" << std::endl;
+      return 1;
+    }
+  // the local processes keep the server (and client) until the emulation ends
+  Time appStop = Seconds (emulate ? stopTime : 10.0);
+
+  if (emulate)
+    {
+      // run against the wall clock and produce frames real stacks will accept
+      GlobalValue::Bind ("SimulatorImplementationType", StringValue ("ns3::RealtimeSimulatorImpl"));
+      GlobalValue::Bind ("ChecksumEnabled", BooleanValue (true));
+      Config::SetDefault ("ns3::RealtimeSimulatorImpl::SynchronizationMode", StringValue ("BestEffort"));
+      g_lagWarn = Seconds (lagWarn);
+    }
   
   Time::SetResolution (Time::NS);
-  LogComponentEnable ("UdpClient", LOG_LEVEL_INFO);
-  LogComponentEnable ("UdpServer", LOG_LEVEL_INFO);
+  if (!report.IsBench ())
+    {
+      LogComponentEnable ("UdpClient", LOG_LEVEL_INFO);
+      LogComponentEnable ("UdpServer", LOG_LEVEL_INFO);
+    }
 
   NodeContainer nodes;
   nodes.Create (2);
@@ -33,6 +617,26 @@ main (int argc, char *argv[])
   NetDeviceContainer devices;
   devices = pointToPoint.Install (nodes);
 
+  // bridge node 0 to the local side; frames are read and written as DIX ethernet
+  NetDeviceContainer emuDevices;
+  Ptr<BatchFdNetDevice> bridge;
+  if (emulate)
+    {
+      int fd = emuFd >= 0 ? emuFd : OpenPacketSocket (emuDevice);
+      if (fd < 0)
+        {
+          std::cout << "cannot open a packet socket on " << emuDevice << ": " << std::strerror (errno) << std::endl;
+          return 1;
+        }
+      bridge = CreateObject<BatchFdNetDevice> ();
+      bridge->SetAddress (Mac48Address::Allocate ());
+      bridge->SetFileDescriptor (fd);
+      bridge->SetBatchSize (emuBatch);
+      nodes.Get (0)->AddDevice (bridge);
+      emuDevices.Add (bridge);
+      Simulator::ScheduleWithContext (nodes.Get (0)->GetId (), Seconds (0), &BatchFdNetDevice::Start, bridge);
+    }
+
   InternetStackHelper stack;
   stack.Install (nodes);
 
@@ -41,28 +645,67 @@ main (int argc, char *argv[])
 
   Ipv4InterfaceContainer interfaces = address.Assign (devices);
 
+  if (emulate)
+    {
+      // local test processes sit on 192.168.1.0/24 with node 0 as their gateway
+      address.SetBase ("192.168.1.0", "255.255.255.0");
+      address.Assign (emuDevices);
+
+      Ipv4StaticRoutingHelper staticRouting;
+      Ptr<Ipv4StaticRouting> serverRouting = staticRouting.GetStaticRouting (nodes.Get (1)->GetObject<Ipv4> ());
+      serverRouting->AddNetworkRouteTo (Ipv4Address ("192.168.1.0"), Ipv4Mask ("255.255.255.0"), interfaces.GetAddress (0), 1);
+
+      emuDevices.Get (0)->TraceConnectWithoutContext ("MacRx", MakeCallback (&EmuRx));
+      Simulator::Schedule (Seconds (lagInterval), &SampleRealtimeLag, Seconds (lagInterval));
+      Simulator::Stop (Seconds (stopTime));
+    }
+
   UdpServerHelper echoServer (9);
 
   ApplicationContainer serverApps = echoServer.Install (nodes.Get (1));
   serverApps.Start (Seconds (1.0));
-  serverApps.Stop (Seconds (10.0));
+  serverApps.Stop (appStop);
 
   UdpClientHelper echoClient (interfaces.GetAddress (1), 9);
-  echoClient.SetAttribute ("MaxPackets", UintegerValue (1));
-  echoClient.SetAttribute ("Interval", TimeValue (Seconds (1.0)));
+  echoClient.SetAttribute ("MaxPackets", UintegerValue (nPackets));
+  echoClient.SetAttribute ("Interval", TimeValue (Seconds (interval)));
   echoClient.SetAttribute ("PacketSize", UintegerValue (1024));
 
   ApplicationContainer clientApps = echoClient.Install (nodes.Get (0));
   clientApps.Start (Seconds (2.0));
-  clientApps.Stop (Seconds (10.0));
+  clientApps.Stop (appStop);
 
 
-  AnimationInterface anim("UDP.xml");
+  // no animation in timed runs
+  AnimationInterface *anim = 0;
+  if (!report.IsBench ())
+    {
+      anim = new AnimationInterface ("UDP.xml");
   
-  anim.SetConstantPosition(nodes.Get(0),10.0,15.0);
-  anim.SetConstantPosition(nodes.Get(1),30.0,15.0);
+      anim->SetConstantPosition(nodes.Get(0),10.0,15.0);
+      anim->SetConstantPosition(nodes.Get(1),30.0,15.0);
+    }
   
+  report.Start (Seconds (stopTime));
   Simulator::Run ();
+  report.Stop ();
+
+  if (emulate && g_lagSamples > 0)
+    {
+      std::cout << "Real-time lag: samples " << g_lagSamples
+                << " mean " << g_lagSum.GetMicroSeconds () / (int64_t) g_lagSamples << "us"
+                << " max " << g_lagMax.GetMicroSeconds () << "us"
+                << " late " << g_lagLate << " (over " << g_lagWarn.GetMicroSeconds () << "us)" << std::endl;
+    }
+  if (bridge)
+    {
+      std::cout << "Emulated link: rx " << bridge->GetRxFrames () << " frames in " << bridge->GetRxBatches () << " batches"
+                << ", tx " << bridge->GetTxFrames () << " frames in " << bridge->GetTxCalls () << " sendmmsg calls"
+                << ", tx dropped " << bridge->GetTxDropped ()
+                << (bridge->IsPeerClosed () ? ", closed by the peer" : "") << std::endl;
+    }
+
   Simulator::Destroy ();
-  return 0;
+  delete anim;
+  return report.Finish () ? 0 : 1;
 }
@@ -0,0 +1,97 @@
+#!/bin/sh
+# Checks that the beacon abstraction in wifi.cc (--beaconAbstraction) leaves
+# the data plane intact. The scenario runs once with real beacons and once
+# with abstracted ones, with echo traffic from every station and the same
+# beacon interval. The script then checks:
+#   - association and disassociation counts are equal;
+#   - echo replies and FlowMonitor receive totals agree within the tolerance,
+#     in either direction;
+#   - the abstraction actually ran and no station lost the access point.
+#
+#   NS3_DIR=~/ns-3-dev ./wifi-beacon-check.sh [beaconTus] [tolerance]
+#
+# The scenario scripts must be in $NS3_DIR/scratch. beaconTus defaults to
+# 100, the ns-3 default, and tolerance is the allowed fractional difference
+# in received packets (default 0.02).
+
+NS3_DIR=${NS3_DIR:?set NS3_DIR to the ns-3 tree with these scripts in scratch/}
+BEACON_TUS=${1:-100}
+TOLERANCE=${2:-0.02}
+ARGS="--nWifi=9 --allStations --nPackets=150 --interval=0.05 --digest --beaconTus=$BEACON_TUS"
+
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+run ()
+{
+  if ! "$NS3_DIR/waf" --cwd="$WORK" --run "wifi $ARGS $2" > "$WORK/$1.log" 2>&1; then
+    cat "$WORK/$1.log"
+    echo "FAIL: wifi $ARGS $2 did not run"
+    exit 1
+  fi
+}
+
+# field N of "Echo client sent S received R, associations A, disassociations D, ..."
+echo_field ()
+{
+  sed -n "s/^Echo client sent \([0-9]*\) received \([0-9]*\), associations \([0-9]*\), disassociations \([0-9]*\), events \([0-9]*\).*/\\$2/p" "$WORK/$1.log"
+}
+
+# field N of "Beacons abstracted B, stations that lost the access point L"
+beacon_field ()
+{
+  sed -n "s/^Beacons abstracted \([0-9]*\), stations that lost the access point \([0-9]*\)$/\\$2/p" "$WORK/$1.log"
+}
+
+# received packets summed over the FlowMonitor lines of the digest:
+#   flow ID SRC DST proto P tx PACKETS/BYTES rx PACKETS/BYTES lost L delay D
+flow_rx ()
+{
+  awk '$1 == "flow" { split ($10, rx, "/"); sum += rx[1] } END { print sum + 0 }' "$WORK/$1.log"
+}
+
+# fails unless |OTHER - BASE| <= BASE * TOLERANCE
+within ()
+{
+  awk -v base="$2" -v other="$3" -v tol="$TOLERANCE" \
+    'BEGIN { d = other - base; if (d < 0) d = -d; exit !(d <= base * tol) }'
+}
+
+run full ""
+run abstract "--beaconAbstraction"
+
+status=0
+for name in full abstract; do
+  printf '%-8s echo sent %s received %s, associations %s, disassociations %s, events %s, flow rx %s\n' \
+    "$name" "$(echo_field $name 1)" "$(echo_field $name 2)" "$(echo_field $name 3)" \
+    "$(echo_field $name 4)" "$(echo_field $name 5)" "$(flow_rx $name)"
+done
+
+if [ -z "$(echo_field full 2)" ] || [ -z "$(echo_field abstract 2)" ]; then
+  echo "FAIL: no echo summary in the output"
+  exit 1
+fi
+beacons=$(beacon_field abstract 1)
+lost=$(beacon_field abstract 2)
+echo "abstract beacons abstracted ${beacons:--}, stations that lost the access point ${lost:--}"
+if [ -z "$beacons" ] || [ "$beacons" -eq 0 ]; then
+  echo "FAIL: no beacons were abstracted; not every station associated"
+  status=1
+elif [ "$lost" -ne 0 ]; then
+  echo "FAIL: $lost stations left the access point's range while beacons were abstracted"
+  status=1
+fi
+if [ "$(echo_field full 3)" != "$(echo_field abstract 3)" ] || [ "$(echo_field full 4)" != "$(echo_field abstract 4)" ]; then
+  echo "FAIL: association counts differ"
+  status=1
+fi
+if ! within "echo replies" "$(echo_field full 2)" "$(echo_field abstract 2)"; then
+  echo "FAIL: echo replies differ by more than $TOLERANCE"
+  status=1
+fi
+if ! within "flow rx" "$(flow_rx full)" "$(flow_rx abstract)"; then
+  echo "FAIL: FlowMonitor packets received differ by more than $TOLERANCE"
+  status=1
+fi
+[ $status -eq 0 ] && echo "PASS: abstracted beacons at beaconTus=$BEACON_TUS keep the data plane within $TOLERANCE"
+exit $status
@@ -0,0 +1,73 @@
+#!/bin/sh
+# Checks that the array-based random walk in wifi.cc (--soaMobility) moves
+# the stations along the same trajectories as per-node
+# RandomWalk2dMobilityModel. Both runs use a 1 s walk step and the same
+# fixed mobility streams, and print every station's final position. The
+# script fails unless each station ends up within the allowed distance in
+# both runs.
+#
+#   NS3_DIR=~/ns-3-dev ./wifi-mobility-check.sh [nWifi] [stream] [epsilon]
+#
+# The scenario scripts must be in $NS3_DIR/scratch. nWifi defaults to 30,
+# stream to 1000, and epsilon, in metres per coordinate, to 1e-6.
+
+NS3_DIR=${NS3_DIR:?set NS3_DIR to the ns-3 tree with these scripts in scratch/}
+N_WIFI=${1:-30}
+STREAM=${2:-1000}
+EPSILON=${3:-1e-6}
+ARGS="--nWifi=$N_WIFI --walkTime=1 --mobilityStream=$STREAM --showPositions --bench"
+
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+run ()
+{
+  if ! "$NS3_DIR/waf" --cwd="$WORK" --run "wifi $ARGS $2" > "$WORK/$1.log" 2>&1; then
+    cat "$WORK/$1.log"
+    echo "FAIL: wifi $ARGS $2 did not run"
+    exit 1
+  fi
+  # "Station I at X Y" lines, as "I X Y"
+  sed -n 's/^Station \([0-9]*\) at \([^ ]*\) \([^ ]*\)$/\1 \2 \3/p' "$WORK/$1.log" > "$WORK/$1.positions"
+}
+
+run nodes ""
+run soa "--soaMobility"
+
+# every station in both runs, each coordinate within EPSILON
+awk -v n="$N_WIFI" -v eps="$EPSILON" '
+  function abs (v) { return v < 0 ? -v : v }
+  NR == FNR { x[$1] = $2; y[$1] = $3; next }
+  {
+    seen[$1] = 1
+    if (!($1 in x))
+      {
+        printf "station %s only in the --soaMobility run\n", $1
+        bad++
+      }
+    else if (abs ($2 - x[$1]) > eps || abs ($3 - y[$1]) > eps)
+      {
+        printf "station %s at %s %s per node, %s %s with --soaMobility\n", $1, x[$1], y[$1], $2, $3
+        bad++
+      }
+  }
+  END {
+    for (i = 0; i < n; i++)
+      {
+        if (!(i in seen))
+          {
+            printf "station %d has no --soaMobility position\n", i
+            bad++
+          }
+        else if (!(i in x))
+          {
+            printf "station %d has no per-node position\n", i
+            bad++
+          }
+      }
+    exit bad > 0
+  }' "$WORK/nodes.positions" "$WORK/soa.positions"
+status=$?
+[ $status -eq 0 ] && echo "PASS: $N_WIFI stations follow the same trajectories within $EPSILON"
+[ $status -ne 0 ] && echo "FAIL: trajectories differ"
+exit $status
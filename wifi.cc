@@ -8,37 +8,624 @@
 #include "ns3/mobility-module.h"
 #include "ns3/yans-wifi-helper.h"
 #include "ns3/ssid.h"
+#include "ns3/ap-wifi-mac.h"
+#include "ns3/sta-wifi-mac.h"
+#include "ns3/wifi-net-device.h"
+#include "ns3/wifi-phy-state-helper.h"
+#include "ns3/wifi-mac-header.h"
+#include "ns3/propagation-loss-model.h"
 #include "ns3/netanim-module.h"
+#include "perf-report.h"
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <vector>
 
 using namespace ns3;
 
 NS_LOG_COMPONENT_DEFINE("Bus_script");
 
+// data-plane and association counters, compared between runs with real and
+// abstracted beacons by wifi-beacon-check.sh
+static uint32_t g_echoTx = 0;
+static uint32_t g_echoRx = 0;
+static uint64_t g_echoRxBytes = 0;
+static uint32_t g_assoc = 0;
+static uint32_t g_deassoc = 0;
+
+static void
+EchoTx (Ptr<const Packet> packet)
+{
+  g_echoTx++;
+}
+
+static void
+EchoRx (Ptr<const Packet> packet)
+{
+  g_echoRx++;
+  g_echoRxBytes += packet->GetSize ();
+}
+
+static void
+StaAssoc (Mac48Address bssid)
+{
+  g_assoc++;
+}
+
+static void
+StaDeAssoc (Mac48Address bssid)
+{
+  g_deassoc++;
+}
+
+/*
+ * Time-mode random walk for all stations, kept as structure-of-arrays.
+ * Stations that change direction at the same instants form a cohort, and
+ * one sweep per step over the cohort replaces the per-node walk and rebound
+ * events. All stations start in one cohort. Between sweeps a position is
+ * only computed when queried, by moving from the station's last waypoint
+ * and folding the path back into the bounds. Each station draws speed and
+ * then direction from its own pair of streams, like
+ * RandomWalk2dMobilityModel, so both give the same trajectories under the
+ * same streams.
+ */
+class RandomWalkSoa : public SimpleRefCount<RandomWalkSoa>
+{
+public:
+  RandomWalkSoa (Rectangle bounds, Time step);
+
+  uint32_t Add (const Vector &position);
+  void Start (void);
+  Vector GetPosition (uint32_t i) const;
+  Vector GetVelocity (uint32_t i) const;
+  void SetPosition (uint32_t i, const Vector &position);
+  int64_t AssignStreams (uint32_t i, int64_t stream);
+
+private:
+  // stations sharing a step timer
+  struct Cohort
+  {
+    std::vector<uint32_t> members;
+    Time start; // time of the first sweep
+    EventId sweep;
+  };
+
+  // index k of a sweep is station k when one cohort holds every station
+  struct AllStations
+  {
+    uint32_t operator[] (uint32_t k) const
+    {
+      return k;
+    }
+  };
+
+  void Sweep (uint32_t cohort);
+  template <typename Stations>
+  void Move (const Stations &stations, uint32_t n, double now);
+  void Leave (uint32_t i);
+  static double Reflect (double x, double lo, double hi, bool &flipped);
+
+  Rectangle m_bounds;
+  Time m_step;
+  bool m_started;
+  std::vector<Cohort> m_cohorts;
+  std::vector<uint32_t> m_cohortOf;
+  std::vector<double> m_t0; // time of each station's last waypoint, in seconds
+  std::vector<double> m_x;
+  std::vector<double> m_y;
+  std::vector<double> m_z;
+  std::vector<double> m_vx;
+  std::vector<double> m_vy;
+  std::vector<Ptr<UniformRandomVariable> > m_speed;
+  std::vector<Ptr<UniformRandomVariable> > m_direction;
+};
+
+RandomWalkSoa::RandomWalkSoa (Rectangle bounds, Time step)
+  : m_bounds (bounds),
+    m_step (step),
+    m_started (false),
+    m_cohorts (1)
+{
+}
+
+uint32_t
+RandomWalkSoa::Add (const Vector &position)
+{
+  // same speed and direction distributions as RandomWalk2dMobilityModel
+  Ptr<UniformRandomVariable> speed = CreateObject<UniformRandomVariable> ();
+  speed->SetAttribute ("Min", DoubleValue (2.0));
+  speed->SetAttribute ("Max", DoubleValue (4.0));
+  Ptr<UniformRandomVariable> direction = CreateObject<UniformRandomVariable> ();
+  direction->SetAttribute ("Min", DoubleValue (0.0));
+  direction->SetAttribute ("Max", DoubleValue (6.283184));
+
+  m_cohorts[0].members.push_back (m_x.size ());
+  m_cohortOf.push_back (0);
+  m_t0.push_back (Simulator::Now ().GetSeconds ());
+  m_x.push_back (position.x);
+  m_y.push_back (position.y);
+  m_z.push_back (position.z);
+  m_vx.push_back (0.0);
+  m_vy.push_back (0.0);
+  m_speed.push_back (speed);
+  m_direction.push_back (direction);
+  return m_x.size () - 1;
+}
+
+void
+RandomWalkSoa::Start (void)
+{
+  m_started = true;
+  m_cohorts[0].start = Simulator::Now ();
+  m_cohorts[0].sweep = Simulator::ScheduleNow (&RandomWalkSoa::Sweep, this, 0);
+}
+
+double
+RandomWalkSoa::Reflect (double x, double lo, double hi, bool &flipped)
+{
+  double width = hi - lo;
+  double u = std::fmod (x - lo, 2 * width);
+  if (u < 0)
+    {
+      u += 2 * width;
+    }
+  // an odd number of bounces leaves the walker heading back
+  flipped = (u > width);
+  return flipped ? hi - (u - width) : lo + u;
+}
+
+Vector
+RandomWalkSoa::GetPosition (uint32_t i) const
+{
+  double dt = Simulator::Now ().GetSeconds () - m_t0[i];
+  bool flipped;
+  double x = Reflect (m_x[i] + m_vx[i] * dt, m_bounds.xMin, m_bounds.xMax, flipped);
+  double y = Reflect (m_y[i] + m_vy[i] * dt, m_bounds.yMin, m_bounds.yMax, flipped);
+  return Vector (x, y, m_z[i]);
+}
+
+Vector
+RandomWalkSoa::GetVelocity (uint32_t i) const
+{
+  double dt = Simulator::Now ().GetSeconds () - m_t0[i];
+  bool flipX;
+  bool flipY;
+  Reflect (m_x[i] + m_vx[i] * dt, m_bounds.xMin, m_bounds.xMax, flipX);
+  Reflect (m_y[i] + m_vy[i] * dt, m_bounds.yMin, m_bounds.yMax, flipY);
+  return Vector (flipX ? -m_vx[i] : m_vx[i], flipY ? -m_vy[i] : m_vy[i], 0.0);
+}
+
+void
+RandomWalkSoa::SetPosition (uint32_t i, const Vector &position)
+{
+  m_t0[i] = Simulator::Now ().GetSeconds ();
+  m_x[i] = position.x;
+  m_y[i] = position.y;
+  m_z[i] = position.z;
+  m_vx[i] = 0.0;
+  m_vy[i] = 0.0;
+  if (!m_started)
+    {
+      return;
+    }
+
+  // like RandomWalk2dMobilityModel, draw a new leg right away and restart
+  // the station's step timer from now; stations moved at the same instant
+  // share one new cohort
+  Leave (i);
+  uint32_t c = m_cohorts.size ();
+  for (uint32_t j = 0; j < m_cohorts.size (); ++j)
+    {
+      if (m_cohorts[j].start == Simulator::Now () && m_cohorts[j].sweep.IsRunning ())
+        {
+          c = j;
+          break;
+        }
+      if (m_cohorts[j].members.empty () && c == m_cohorts.size ())
+        {
+          c = j;
+        }
+    }
+  if (c == m_cohorts.size ())
+    {
+      m_cohorts.push_back (Cohort ());
+    }
+  if (m_cohorts[c].members.empty ())
+    {
+      m_cohorts[c].start = Simulator::Now ();
+      m_cohorts[c].sweep = Simulator::ScheduleNow (&RandomWalkSoa::Sweep, this, c);
+    }
+  m_cohorts[c].members.push_back (i);
+  m_cohortOf[i] = c;
+}
+
+void
+RandomWalkSoa::Leave (uint32_t i)
+{
+  Cohort &cohort = m_cohorts[m_cohortOf[i]];
+  cohort.members.erase (std::find (cohort.members.begin (), cohort.members.end (), i));
+  if (cohort.members.empty ())
+    {
+      cohort.sweep.Cancel ();
+    }
+}
+
+int64_t
+RandomWalkSoa::AssignStreams (uint32_t i, int64_t stream)
+{
+  m_speed[i]->SetStream (stream);
+  m_direction[i]->SetStream (stream + 1);
+  return 2;
+}
+
+void
+RandomWalkSoa::Sweep (uint32_t cohort)
+{
+  double now = Simulator::Now ().GetSeconds ();
+  const std::vector<uint32_t> &members = m_cohorts[cohort].members;
+  // each station draws from its own streams, so the order of the members
+  // does not matter and a cohort of everyone can run over the arrays as they are
+  if (members.size () == m_x.size ())
+    {
+      Move (AllStations (), m_x.size (), now);
+    }
+  else
+    {
+      Move (members, members.size (), now);
+    }
+  m_cohorts[cohort].sweep = Simulator::Schedule (m_step, &RandomWalkSoa::Sweep, this, cohort);
+}
+
+template <typename Stations>
+void
+RandomWalkSoa::Move (const Stations &stations, uint32_t n, double now)
+{
+  // advance every waypoint to now in plain loops over the arrays
+  for (uint32_t k = 0; k < n; ++k)
+    {
+      uint32_t i = stations[k];
+      m_x[i] += m_vx[i] * (now - m_t0[i]);
+      m_y[i] += m_vy[i] * (now - m_t0[i]);
+      m_t0[i] = now;
+    }
+  bool flipped;
+  for (uint32_t k = 0; k < n; ++k)
+    {
+      uint32_t i = stations[k];
+      m_x[i] = Reflect (m_x[i], m_bounds.xMin, m_bounds.xMax, flipped);
+      m_y[i] = Reflect (m_y[i], m_bounds.yMin, m_bounds.yMax, flipped);
+    }
+
+  // draw the next leg, speed before direction as the per-node model does
+  for (uint32_t k = 0; k < n; ++k)
+    {
+      uint32_t i = stations[k];
+      double speed = m_speed[i]->GetValue ();
+      double direction = m_direction[i]->GetValue ();
+      m_vx[i] = std::cos (direction) * speed;
+      m_vy[i] = std::sin (direction) * speed;
+    }
+}
+
+/*
+ * Per-node view of a RandomWalkSoa, so the station is still found through
+ * GetObject<MobilityModel> (). Course changes are not fired; the wifi
+ * channel and NetAnim query positions when they need them.
+ */
+class SoaWalkMobilityModel : public MobilityModel
+{
+public:
+  static TypeId GetTypeId (void);
+  SoaWalkMobilityModel ();
+
+  void Attach (Ptr<RandomWalkSoa> walk);
+
+private:
+  virtual Vector DoGetPosition (void) const;
+  virtual void DoSetPosition (const Vector &position);
+  virtual Vector DoGetVelocity (void) const;
+  virtual int64_t DoAssignStreams (int64_t stream);
+
+  Ptr<RandomWalkSoa> m_walk;
+  uint32_t m_index;
+  int64_t m_stream; // stream assigned before the model was attached, or -1
+  Vector m_position; // position given before the model is attached
+};
+
+NS_OBJECT_ENSURE_REGISTERED (SoaWalkMobilityModel);
+
+TypeId
+SoaWalkMobilityModel::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::SoaWalkMobilityModel")
+    .SetParent<MobilityModel> ()
+    .SetGroupName ("Mobility")
+    .AddConstructor<SoaWalkMobilityModel> ();
+  return tid;
+}
+
+SoaWalkMobilityModel::SoaWalkMobilityModel ()
+  : m_index (0),
+    m_stream (-1)
+{
+}
+
+void
+SoaWalkMobilityModel::Attach (Ptr<RandomWalkSoa> walk)
+{
+  m_walk = walk;
+  m_index = walk->Add (m_position);
+  if (m_stream >= 0)
+    {
+      walk->AssignStreams (m_index, m_stream);
+    }
+}
+
+Vector
+SoaWalkMobilityModel::DoGetPosition (void) const
+{
+  return m_walk ? m_walk->GetPosition (m_index) : m_position;
+}
+
+void
+SoaWalkMobilityModel::DoSetPosition (const Vector &position)
+{
+  if (m_walk)
+    {
+      m_walk->SetPosition (m_index, position);
+    }
+  else
+    {
+      m_position = position;
+    }
+}
+
+Vector
+SoaWalkMobilityModel::DoGetVelocity (void) const
+{
+  return m_walk ? m_walk->GetVelocity (m_index) : Vector (0.0, 0.0, 0.0);
+}
+
+int64_t
+SoaWalkMobilityModel::DoAssignStreams (int64_t stream)
+{
+  // a station not yet handed to the walk takes its streams along on Attach
+  if (!m_walk)
+    {
+      m_stream = stream;
+      return 2;
+    }
+  return m_walk->AssignStreams (m_index, stream);
+}
+
+/*
+ * Beacon abstraction for runs with many stations. Once every station has
+ * associated, the access point stops generating beacons, and one event per
+ * beacon interval stands in for each beacon, for all stations at once:
+ *   - every PHY in range of the access point, its own included, sees the
+ *     medium busy for the airtime of the last real beacon, so channel access
+ *     still defers around it;
+ *   - each station in range is credited with the beacon, and one that misses
+ *     MaxMissedBeacons of them in a row is counted as having lost the access
+ *     point.
+ * MaxMissedBeacons is raised before the last real beacon, so the stations'
+ * own beacon watchdogs no longer fire and a station out of range is
+ * reported rather than disassociated.
+ */
+class BeaconAbstraction : public SimpleRefCount<BeaconAbstraction>
+{
+public:
+  BeaconAbstraction (Ptr<WifiNetDevice> ap, const NetDeviceContainer &stations);
+
+  uint64_t GetBeacons (void) const;
+  uint32_t GetLost (void) const;
+
+private:
+  void StationAssoc (Mac48Address bssid);
+  void StationDeAssoc (Mac48Address bssid);
+  void ApTxBegin (Ptr<const Packet> packet, double txPowerW);
+  void ApTxEnd (Ptr<const Packet> packet);
+  void Beacon (void);
+
+  Ptr<WifiNetDevice> m_ap;
+  std::vector<Ptr<WifiNetDevice> > m_stations;
+  Ptr<PropagationLossModel> m_loss;
+  Time m_interval;
+  uint32_t m_associated;
+  uint32_t m_maxMissed; // the stations' MaxMissedBeacons before it was raised
+  bool m_armed; // every station associated; the next beacon is the last real one
+  bool m_active;
+  uint64_t m_lastUid;
+  Time m_lastStart;
+  Time m_airtime;
+  std::vector<uint32_t> m_missed;
+  uint64_t m_beacons;
+  uint32_t m_lost;
+};
+
+BeaconAbstraction::BeaconAbstraction (Ptr<WifiNetDevice> ap, const NetDeviceContainer &stations)
+  : m_ap (ap),
+    m_loss (CreateObject<LogDistancePropagationLossModel> ()),
+    m_associated (0),
+    m_maxMissed (0),
+    m_armed (false),
+    m_active (false),
+    m_lastUid (0),
+    m_missed (stations.GetN (), 0),
+    m_beacons (0),
+    m_lost (0)
+{
+  // YansWifiChannelHelper::Default () gives the channel a log-distance loss
+  // model with these default attributes, so both see the same received power
+  TimeValue interval;
+  ap->GetMac ()->GetAttribute ("BeaconInterval", interval);
+  m_interval = interval.Get ();
+  for (uint32_t i = 0; i < stations.GetN (); ++i)
+    {
+      Ptr<WifiNetDevice> station = DynamicCast<WifiNetDevice> (stations.Get (i));
+      m_stations.push_back (station);
+      station->GetMac ()->TraceConnectWithoutContext ("Assoc", MakeCallback (&BeaconAbstraction::StationAssoc, this));
+      station->GetMac ()->TraceConnectWithoutContext ("DeAssoc", MakeCallback (&BeaconAbstraction::StationDeAssoc, this));
+    }
+  ap->GetPhy ()->TraceConnectWithoutContext ("PhyTxBegin", MakeCallback (&BeaconAbstraction::ApTxBegin, this));
+  ap->GetPhy ()->TraceConnectWithoutContext ("PhyTxEnd", MakeCallback (&BeaconAbstraction::ApTxEnd, this));
+}
+
+uint64_t
+BeaconAbstraction::GetBeacons (void) const
+{
+  return m_beacons;
+}
+
+uint32_t
+BeaconAbstraction::GetLost (void) const
+{
+  return m_lost;
+}
+
+void
+BeaconAbstraction::StationAssoc (Mac48Address bssid)
+{
+  if (++m_associated < m_stations.size () || m_armed)
+    {
+      return;
+    }
+  // the next beacon sets every watchdog from the raised limit; no more
+  // than a million intervals, so the watchdog time cannot overflow
+  m_armed = true;
+  UintegerValue maxMissed;
+  m_stations[0]->GetMac ()->GetAttribute ("MaxMissedBeacons", maxMissed);
+  m_maxMissed = maxMissed.Get ();
+  for (uint32_t i = 0; i < m_stations.size (); ++i)
+    {
+      m_stations[i]->GetMac ()->SetAttribute ("MaxMissedBeacons", UintegerValue (1000000));
+    }
+}
+
+void
+BeaconAbstraction::StationDeAssoc (Mac48Address bssid)
+{
+  m_associated--;
+}
+
+void
+BeaconAbstraction::ApTxBegin (Ptr<const Packet> packet, double txPowerW)
+{
+  WifiMacHeader header;
+  if (!m_armed || m_active || packet->PeekHeader (header) == 0 || !header.IsBeacon ())
+    {
+      return;
+    }
+  // the next beacon is already scheduled; switching generation off cancels it
+  m_active = true;
+  m_lastUid = packet->GetUid ();
+  m_lastStart = Simulator::Now ();
+  m_ap->GetMac ()->SetAttribute ("BeaconGeneration", BooleanValue (false));
+}
+
+void
+BeaconAbstraction::ApTxEnd (Ptr<const Packet> packet)
+{
+  if (m_active && m_airtime.IsZero () && packet->GetUid () == m_lastUid)
+    {
+      m_airtime = Simulator::Now () - m_lastStart;
+      Simulator::Schedule (m_lastStart + m_interval - Simulator::Now (), &BeaconAbstraction::Beacon, this);
+    }
+}
+
+void
+BeaconAbstraction::Beacon (void)
+{
+  m_beacons++;
+  Ptr<WifiPhy> apPhy = m_ap->GetPhy ();
+  Ptr<MobilityModel> apPosition = m_ap->GetNode ()->GetObject<MobilityModel> ();
+  double txPowerDbm = apPhy->GetTxPowerStart ();
+  apPhy->GetState ()->SwitchMaybeToCcaBusy (m_airtime);
+  for (uint32_t i = 0; i < m_stations.size (); ++i)
+    {
+      Ptr<WifiPhy> phy = m_stations[i]->GetPhy ();
+      double rxPowerDbm = m_loss->CalcRxPower (txPowerDbm, apPosition, m_stations[i]->GetNode ()->GetObject<MobilityModel> ());
+      if (rxPowerDbm >= phy->GetRxSensitivity ())
+        {
+          phy->GetState ()->SwitchMaybeToCcaBusy (m_airtime);
+          m_missed[i] = 0;
+        }
+      else if (++m_missed[i] == m_maxMissed)
+        {
+          m_lost++;
+        }
+    }
+  Simulator::Schedule (m_interval, &BeaconAbstraction::Beacon, this);
+}
+
 int 
 main (int argc, char *argv[])
 {
   
   uint32_t nCsma = 3;
   uint32_t nWifi = 3;
+  uint32_t beaconTus = 100;
+  std::string activeProbing = "auto";
+  uint32_t nPackets = 1;
+  double interval = 1.0;
+  bool allStations = false;
+  double walkTime = 0.0;
+  bool soaMobility = false;
+  int64_t mobilityStream = -1;
+  bool showPositions = false;
+  bool beaconAbstraction = false;
+  PerfReport report;
 
   CommandLine cmd (__FILE__);
+  cmd.AddValue ("nCsma", "Number of additional csma nodes on the bus", nCsma);
+  cmd.AddValue ("nWifi", "Number of wifi station nodes", nWifi);
+  cmd.AddValue ("walkTime", "Stations change direction every walkTime seconds instead of every metre (0 keeps the distance mode)", walkTime);
+  cmd.AddValue ("soaMobility", "Move all stations with one array-based random walk instead of per-node models", soaMobility);
+  cmd.AddValue ("mobilityStream", "First random stream for station mobility (-1 leaves automatic assignment)", mobilityStream);
+  cmd.AddValue ("showPositions", "Print every station position at the end of the run", showPositions);
+  cmd.AddValue ("beaconTus", "AP beacon interval in time units of 1024 us", beaconTus);
+  cmd.AddValue ("beaconAbstraction", "Once all stations have associated, replace the AP beacons with one batched event per beacon interval", beaconAbstraction);
+  cmd.AddValue ("activeProbing", "Associate stations by probing instead of waiting for a beacon: true, false, or auto (probe when beaconTus > 100)", activeProbing);
+  cmd.AddValue ("nPackets", "Number of packets sent by each echo client", nPackets);
+  cmd.AddValue ("interval", "Interval in seconds between echo client packets", interval);
+  cmd.AddValue ("allStations", "Run an echo client on every station instead of one", allStations);
+  report.AddCommandLine (cmd);
   cmd.Parse(argc,argv);
   
-  // no of wifi nodes should be less than 18
-  if (nWifi > 18)
+  // the single echo client runs on the last station
+  if (nWifi < 1)
+    {
+      std::cout << "nWifi should be at least 1" << std::endl;
+      return 1;
+    }
+
+  // with passive scanning a station cannot associate before its first beacon,
+  // which may come a whole interval after start-up; a long interval could then
+  // leave stations unassociated when the clients start at 2 s
+  if (activeProbing != "auto" && activeProbing != "true" && activeProbing != "false")
     {
-      std::cout << "nWifi should be 18 or less; otherwise grid layout exceeds the bounding box" << std::endl;
+      std::cout << "activeProbing must be true, false or auto" << std::endl;
       return 1;
     }
+  bool probe = activeProbing == "true" || (activeProbing == "auto" && beaconTus > 100);
+
+  // the array walk sweeps all stations at once, which needs a common step time
+  if (soaMobility && walkTime <= 0)
+    {
+      walkTime = 1.0;
+    }
 
   
   // set time resolution
   Time::SetResolution (Time::NS);
 
-  // enable logging for client and server applications
-  LogComponentEnable ("UdpEchoClientApplication", LOG_LEVEL_INFO);
+  // enable logging for client and server applications, except in timed runs
+  if (!report.IsBench ())
+    {
+      LogComponentEnable ("UdpEchoClientApplication", LOG_LEVEL_INFO);
   
-  LogComponentEnable ("UdpEchoServerApplication", LOG_LEVEL_INFO);
+      LogComponentEnable ("UdpEchoServerApplication", LOG_LEVEL_INFO);
+    }
   
   // Create point to point nodes in p2p topology
   NodeContainer p2pNodes;
@@ -95,14 +682,20 @@ main (int argc, char *argv[])
   Ssid ssid = Ssid ("ns-3-ssid"); //Create SSID from a given string. 
   
   //Specify the type of ns3::WifiMac to create and configure other attributes for wifi nodes
-  mac.SetType ("ns3::StaWifiMac","Ssid", SsidValue (ssid),"ActiveProbing", BooleanValue (false));
+  mac.SetType ("ns3::StaWifiMac","Ssid", SsidValue (ssid),"ActiveProbing", BooleanValue (probe));
  
   // Install configured wifi channel and wifi net devices on wifi nodes
   NetDeviceContainer staDevices;
   staDevices = wifi.Install (phy, mac, wifiStaNodes);
   
   //Specify the type of ns3::WifiMac to create and configure other attributes for wifi access point N0
-  mac.SetType ("ns3::ApWifiMac","Ssid", SsidValue (ssid));
+  //beaconTus is a plain configuration knob: fewer beacons means fewer beacon
+  //receptions for every station to process, but also less beacon airtime, so
+  //the data plane is not the same as at the default. Stations derive their
+  //missed-beacon timeout from the interval carried in the beacon itself.
+  //--beaconAbstraction keeps the interval and the airtime and only takes the
+  //per-station beacon receptions out
+  mac.SetType ("ns3::ApWifiMac","Ssid", SsidValue (ssid),"BeaconInterval", TimeValue (MicroSeconds (1024 * beaconTus)));
   
   // Install configured wifi channel and wifi net devices on wifi access point
   NetDeviceContainer apDevices;
@@ -113,26 +706,75 @@ main (int argc, char *argv[])
   MobilityHelper mobility;
   
   
+  // up to 18 stations sit three to a row of 5 m by 10 m cells inside a
+  // 100 m square; more stations widen the grid so it stays roughly square,
+  // and the walk area grows to cover it
+  uint32_t gridWidth = nWifi <= 18 ? 3 : (uint32_t) std::ceil (std::sqrt (2.0 * nWifi));
+  uint32_t gridRows = (nWifi + gridWidth - 1) / gridWidth;
+  double gridX = 5.0 * (gridWidth - 1);
+  double gridY = gridRows > 0 ? 10.0 * (gridRows - 1) : 0.0;
+  double walkHalf = std::max (50.0, std::max (gridX, gridY));
+  Rectangle walkBounds (-walkHalf, walkHalf, -walkHalf, walkHalf);
+
   // Specify the type of mobility model to use and configure other attributes for wifi nodes.
   mobility.SetPositionAllocator ("ns3::GridPositionAllocator",
                                  "MinX", DoubleValue (0.0),
                                  "MinY", DoubleValue (0.0),
                                  "DeltaX", DoubleValue (5.0),
                                  "DeltaY", DoubleValue (10.0),
-                                 "GridWidth", UintegerValue (3),
+                                 "GridWidth", UintegerValue (gridWidth),
                                  "LayoutType", StringValue ("RowFirst"));
  
   //will create an instance of a matching mobility model for each wifi node. 
-  mobility.SetMobilityModel ("ns3::RandomWalk2dMobilityModel","Bounds", RectangleValue (Rectangle (-50, 50, -50, 50)));
+  if (soaMobility)
+    {
+      mobility.SetMobilityModel ("ns3::SoaWalkMobilityModel");
+    }
+  else if (walkTime > 0)
+    {
+      mobility.SetMobilityModel ("ns3::RandomWalk2dMobilityModel","Bounds", RectangleValue (walkBounds),
+                                 "Mode", StringValue ("Time"),"Time", TimeValue (Seconds (walkTime)));
+    }
+  else
+    {
+      mobility.SetMobilityModel ("ns3::RandomWalk2dMobilityModel","Bounds", RectangleValue (walkBounds));
+    }
   
   
   //Layout a collection of wifi nodes according to the current position allocator type.
   mobility.Install (wifiStaNodes);
+  
+  //hand every station to one shared walk once the allocator has placed it
+  Ptr<RandomWalkSoa> walk;
+  if (soaMobility)
+    {
+      walk = Create<RandomWalkSoa> (walkBounds, Seconds (walkTime));
+      for (NodeContainer::Iterator i = wifiStaNodes.Begin (); i != wifiStaNodes.End (); ++i)
+        {
+          (*i)->GetObject<SoaWalkMobilityModel> ()->Attach (walk);
+        }
+      walk->Start ();
+    }
+  
+  //fixed streams let a per-node run and an array run be compared trajectory by trajectory
+  if (mobilityStream >= 0)
+    {
+      mobility.AssignStreams (wifiStaNodes, mobilityStream);
+    }
 
   
   //will create an instance of a matching mobility model for access point node. 
   mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
   
+  // on a widened grid the next grid cell would leave the access point in a
+  // corner, out of range of the far stations, so put it in the middle
+  if (nWifi > 18)
+    {
+      Ptr<ListPositionAllocator> apPosition = CreateObject<ListPositionAllocator> ();
+      apPosition->Add (Vector (gridX / 2, gridY / 2, 0.0));
+      mobility.SetPositionAllocator (apPosition);
+    }
+  
   //Layout a access point node according to the current position allocator type.
   mobility.Install (wifiApNode);
  
@@ -163,8 +805,10 @@ main (int argc, char *argv[])
   Ipv4InterfaceContainer csmaInterfaces;
   csmaInterfaces = address.Assign(csmaDevices);
  
-  // Configure and assign ip addresses to the wifi nodes and access point 
-  address.SetBase ("20.0.0.0", "255.255.255.0");
+ 
+  // Configure and assign ip addresses to the wifi nodes and access point;
+  // a /24 holds 253 stations besides the access point
+  address.SetBase ("20.0.0.0", nWifi < 254 ? "255.255.255.0" : "255.255.0.0");
   address.Assign (staDevices);
   address.Assign (apDevices);
   
@@ -180,11 +824,11 @@ main (int argc, char *argv[])
   // configure and install client application on node 0 of p2p topology
   UdpEchoClientHelper echoClient (csmaInterfaces.GetAddress (nCsma), 9);
  
-  echoClient.SetAttribute ("MaxPackets", UintegerValue (1));
-  echoClient.SetAttribute ("Interval", TimeValue (Seconds (1.0)));
+  echoClient.SetAttribute ("MaxPackets", UintegerValue (nPackets));
+  echoClient.SetAttribute ("Interval", TimeValue (Seconds (interval)));
   echoClient.SetAttribute ("PacketSize", UintegerValue (1024));
  
-  ApplicationContainer clientApps = echoClient.Install (wifiStaNodes.Get (2));
+  ApplicationContainer clientApps = echoClient.Install (allStations ? wifiStaNodes : NodeContainer (wifiStaNodes.Get (nWifi - 1)));
   clientApps.Start (Seconds (2.0));
   clientApps.Stop (Seconds (10.0));
  
@@ -197,17 +841,69 @@ main (int argc, char *argv[])
 
   Simulator::Stop (Seconds (10.0));
   
-  AnimationInterface anim("wifi_example.xml");
+  // no animation in timed runs
+  AnimationInterface *anim = 0;
+  if (!report.IsBench ())
+    {
+      anim = new AnimationInterface ("wifi_example.xml");
+  
+      anim->SetConstantPosition(p2pNodes.Get(0),22.0,38.0);
+      anim->SetConstantPosition(csmaNodes.Get(0),42.0,38.0);
+      for (uint32_t i = 1; i <= nCsma; ++i)
+        {
+          anim->SetConstantPosition(csmaNodes.Get(i),52.0 + 10.0 * i,15.0);
+        }
+    }
+  
+  for (uint32_t i = 0; i < clientApps.GetN (); ++i)
+    {
+      clientApps.Get (i)->TraceConnectWithoutContext ("Tx", MakeCallback (&EchoTx));
+      clientApps.Get (i)->TraceConnectWithoutContext ("Rx", MakeCallback (&EchoRx));
+    }
+  Config::ConnectWithoutContext ("/NodeList/*/DeviceList/*/$ns3::WifiNetDevice/Mac/$ns3::StaWifiMac/Assoc", MakeCallback (&StaAssoc));
+  Config::ConnectWithoutContext ("/NodeList/*/DeviceList/*/$ns3::WifiNetDevice/Mac/$ns3::StaWifiMac/DeAssoc", MakeCallback (&StaDeAssoc));
   
-  anim.SetConstantPosition(p2pNodes.Get(0),22.0,38.0);
-  anim.SetConstantPosition(csmaNodes.Get(0),42.0,38.0);
-  anim.SetConstantPosition(csmaNodes.Get(1),62.0,15.0);
-  anim.SetConstantPosition(csmaNodes.Get(2),72.0,15.0);
-  anim.SetConstantPosition(csmaNodes.Get(3),82.0,15.0);
+  Ptr<BeaconAbstraction> beacons;
+  if (beaconAbstraction)
+    {
+      beacons = Create<BeaconAbstraction> (DynamicCast<WifiNetDevice> (apDevices.Get (0)), staDevices);
+    }
   
+  report.Start (Seconds (10.0));
   Simulator::Run ();
+  report.Stop ();
+  
+  // wifi-beacon-check.sh compares these between real and abstracted beacons
+  std::cout << "Echo client sent " << g_echoTx << " received " << g_echoRx
+            << ", associations " << g_assoc << ", disassociations " << g_deassoc
+            << ", events " << Simulator::GetEventCount () << std::endl;
+  // the clients run from 2 s to 10 s
+  std::cout << "Echo goodput " << g_echoRxBytes * 8 / 8.0 / 1000 << " kb/s over " << clientApps.GetN ()
+            << " clients" << std::endl;
+  if (beacons)
+    {
+      std::cout << "Beacons abstracted " << beacons->GetBeacons () << ", stations that lost the access point "
+                << beacons->GetLost () << std::endl;
+    }
+  
+  // enough digits for wifi-mobility-check.sh to compare trajectories closely
+  if (showPositions)
+    {
+      std::cout << std::setprecision (10);
+      for (uint32_t i = 0; i < wifiStaNodes.GetN (); ++i)
+        {
+          Vector position = wifiStaNodes.Get (i)->GetObject<MobilityModel> ()->GetPosition ();
+          std::cout << "Station " << i << " at " << position.x << " " << position.y << std::endl;
+        }
+    }
+  
+  std::ostringstream dataPlane;
+  dataPlane << "echo " << g_echoTx << "/" << g_echoRx << " assoc " << g_assoc << "/" << g_deassoc;
+  report.Record (dataPlane.str ());
+  
   Simulator::Destroy ();
-  return 0;
+  delete anim;
+  return report.Finish () ? 0 : 1;
 }
   
   